@@ -0,0 +1,92 @@
+// Compares filling one shared binner with atomic bins against
+// per-thread shards, from high contention (few bins) to low (many bins).
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <thread>
+
+#include "ivanp/binner/atomic_bin.hh"
+#include "ivanp/binner/sharded.hh"
+
+using namespace ivanp;
+
+using axes = std::tuple<axis_spec<uniform_axis<double>>>;
+using count_hist = binner<unsigned long,axes>;
+using atomic_hist = binner<atomic_count<>,axes,
+  std::vector<atomic_count<>>, atomic_bin_filler<atomic_count<>>>;
+using padded_hist = binner<padded_bin<atomic_count<>>,axes,
+  std::vector<padded_bin<atomic_count<>>>,
+  atomic_bin_filler<padded_bin<atomic_count<>>>>;
+
+template <typename F>
+double time_ms(unsigned nthreads, F f) {
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (unsigned t=0; t<nthreads; ++t) threads.emplace_back(f,t);
+  for (auto& thread : threads) thread.join();
+  const std::chrono::duration<double,std::milli> dt =
+    std::chrono::steady_clock::now() - start;
+  return dt.count();
+}
+
+int main() {
+  const unsigned nthreads = std::max(std::thread::hardware_concurrency(),1u);
+  const unsigned nfills = 1<<22;
+
+  std::vector<double> xs(nfills);
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<double> dist(0,1);
+  for (auto& x : xs) x = dist(gen);
+
+  const auto range = [&](unsigned t){
+    return std::make_pair(nfills/nthreads*t,
+      t+1==nthreads ? nfills : nfills/nthreads*(t+1));
+  };
+
+  std::cout << nthreads << " threads, " << nfills << " fills\n"
+            << std::setw(10) << "nbins"
+            << std::setw(12) << "atomic ms"
+            << std::setw(12) << "padded ms"
+            << std::setw(12) << "sharded ms" << '\n';
+
+  for (unsigned nbins : { 1u, 16u, 1024u, 1u<<16, 1u<<20 }) {
+    const uniform_axis<double> axis(nbins,0,1);
+
+    atomic_hist h1(axis);
+    const double t1 = time_ms(nthreads,[&](unsigned t){
+      const auto r = range(t);
+      for (unsigned i=r.first; i<r.second; ++i) h1.fill(xs[i]);
+    });
+
+    padded_hist h2(axis);
+    const double t2 = time_ms(nthreads,[&](unsigned t){
+      const auto r = range(t);
+      for (unsigned i=r.first; i<r.second; ++i) h2.fill(xs[i]);
+    });
+
+    count_hist h3(axis);
+    auto shards = make_sharded(h3,nthreads);
+    const auto start = std::chrono::steady_clock::now();
+    time_ms(nthreads,[&](unsigned t){
+      const auto r = range(t);
+      for (unsigned i=r.first; i<r.second; ++i) shards.fill(t,xs[i]);
+    });
+    shards.reduce(nthreads);
+    const std::chrono::duration<double,std::milli> t3 =
+      std::chrono::steady_clock::now() - start;
+
+    for (unsigned i=0; i<h3.nbins_total(); ++i)
+      if (h1.bins()[i] != h3.bins()[i] || h2.bins()[i] != h3.bins()[i]) {
+        std::cerr << "results differ in bin " << i << std::endl;
+        return 1;
+      }
+
+    std::cout << std::setw(10) << nbins << std::fixed << std::setprecision(1)
+              << std::setw(12) << t1
+              << std::setw(12) << t2
+              << std::setw(12) << t3.count() << '\n';
+  }
+}
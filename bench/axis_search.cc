@@ -0,0 +1,56 @@
+// Compares container_axis bin lookup with and without the edge lookup table
+// for variable width binnings with 10 to 100k edges.
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+
+#include "ivanp/binner/axis.hh"
+
+using namespace ivanp;
+
+template <typename Axis>
+double time_ns(const Axis& axis, const std::vector<double>& xs,
+               unsigned long& sum) {
+  const auto start = std::chrono::steady_clock::now();
+  for (double x : xs) sum += axis.find_bin(x);
+  const std::chrono::duration<double,std::nano> dt =
+    std::chrono::steady_clock::now() - start;
+  return dt.count() / xs.size();
+}
+
+int main() {
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<double> dist(0,1);
+
+  std::vector<double> xs(1<<22);
+  for (auto& x : xs) x = dist(gen)*1.1 - 0.05;
+
+  std::cout << std::setw(8) << "nedges"
+            << std::setw(16) << "upper_bound ns"
+            << std::setw(16) << "edge_lut ns" << '\n';
+
+  for (unsigned n : { 10u, 100u, 1000u, 10000u, 100000u }) {
+    std::vector<double> edges(n);
+    for (auto& e : edges) e = dist(gen)*dist(gen); // variable widths
+    std::sort(edges.begin(),edges.end());
+
+    const container_axis<std::vector<double>> plain(edges);
+    const container_axis<std::vector<double>,false,true> lut(edges);
+
+    unsigned long s1 = 0, s2 = 0;
+    const double t1 = time_ns(plain,xs,s1);
+    const double t2 = time_ns(lut,xs,s2);
+    if (s1 != s2) {
+      std::cerr << "results differ for " << n << " edges" << std::endl;
+      return 1;
+    }
+
+    std::cout << std::setw(8) << n
+              << std::setw(16) << std::fixed << std::setprecision(2) << t1
+              << std::setw(16) << t2 << '\n';
+  }
+}
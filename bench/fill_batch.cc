@@ -0,0 +1,100 @@
+// Compares binner::fill_batch with a loop over fill for a 2D histogram,
+// and checks that both give the same bins, also with an excep axis
+// next to one without.
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <stdexcept>
+
+#include "ivanp/binner/binner.hh"
+
+using namespace ivanp;
+
+using axis = uniform_axis<double>;
+using hist = binner<double,std::tuple<axis_spec<axis>,axis_spec<axis>>>;
+using mixed_hist = binner<double,std::tuple<
+  axis_spec<axis,false,false,false>, axis_spec<axis,false,false,true>>>;
+
+template <typename F>
+double time_ms(F f) {
+  const auto start = std::chrono::steady_clock::now();
+  f();
+  const std::chrono::duration<double,std::milli> dt =
+    std::chrono::steady_clock::now() - start;
+  return dt.count();
+}
+
+// fill entries in order until one throws, like fill_batch
+template <typename H>
+bool fill_loop(H& h, const std::vector<double>& x,
+  const std::vector<double>& y, const std::vector<double>& w
+) {
+  try {
+    for (size_t k=0; k<x.size(); ++k) h(x[k],y[k],w[k]);
+  } catch (const std::out_of_range&) { return true; }
+  return false;
+}
+template <typename H>
+bool fill_batch(H& h, const std::vector<double>& x,
+  const std::vector<double>& y, const std::vector<double>& w
+) {
+  try {
+    h.fill_batch(x,y,w);
+  } catch (const std::out_of_range&) { return true; }
+  return false;
+}
+
+template <typename H>
+bool same(const H& a, const H& b) {
+  return std::equal(a.begin(),a.end(),b.begin());
+}
+
+int main() {
+  const unsigned n = 1<<22;
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<double> dist(-0.1,1.1);
+
+  std::vector<double> x(n), y(n), w(n);
+  for (auto& v : x) v = dist(gen);
+  for (auto& v : y) v = dist(gen);
+  for (auto& v : w) v = dist(gen);
+
+  hist h1({100,0,1},{100,0,1}), h2 = h1;
+  const double t1 = time_ms([&]{ fill_loop(h1,x,y,w); });
+  const double t2 = time_ms([&]{ fill_batch(h2,x,y,w); });
+  if (!same(h1,h2)) {
+    std::cerr << "fill_batch and fill differ" << std::endl;
+    return 1;
+  }
+  std::cout << std::fixed << std::setprecision(2)
+            << "fill loop  " << std::setw(8) << t1 << " ms\n"
+            << "fill_batch " << std::setw(8) << t2 << " ms\n";
+
+  // out of range on the non-excep axis must not reach the excep guard
+  for (unsigned k=0; k<n; ++k) {
+    if (x[k] < 0 || x[k] >= 1) continue;
+    if (y[k] < 0) y[k] = -y[k];
+    if (y[k] >= 1) y[k] = 2 - y[k] - 1e-9;
+  }
+  x[0] = y[0] = 5; // out on both, dropped by the first axis
+  mixed_hist m1({100,0,1},{100,0,1}), m2 = m1;
+  bool e1 = fill_loop(m1,x,y,w), e2 = fill_batch(m2,x,y,w);
+  if (e1 != e2 || !same(m1,m2)) {
+    std::cerr << "mixed excep fill_batch and fill differ" << std::endl;
+    return 1;
+  }
+
+  // an excep throw stops both at the same entry
+  x[n/2+1] = 0.5;
+  y[n/2+1] = 2;
+  mixed_hist m3({100,0,1},{100,0,1}), m4 = m3;
+  e1 = fill_loop(m3,x,y,w), e2 = fill_batch(m4,x,y,w);
+  if (!e1 || !e2 || !same(m3,m4)) {
+    std::cerr << "mixed excep fill_batch and fill differ on throw"
+              << std::endl;
+    return 1;
+  }
+}
@@ -0,0 +1,131 @@
+#ifndef IVANP_BINNER_ATOMIC_BIN_HH
+#define IVANP_BINNER_ATOMIC_BIN_HH
+
+// Bin types for filling one binner from many threads at once.
+// Updates use relaxed atomics: counts with fetch_add, floating point
+// weights with a compare-and-swap loop.
+// Copying and += are not atomic and must not race with filling.
+
+#include <atomic>
+#include <type_traits>
+
+#ifndef IVANP_CACHE_LINE
+#define IVANP_CACHE_LINE 64
+#endif
+
+namespace ivanp {
+
+template <typename T>
+inline std::enable_if_t<std::is_integral<T>::value>
+atomic_add(std::atomic<T>& a, T x,
+  std::memory_order order = std::memory_order_relaxed
+) noexcept { a.fetch_add(x,order); }
+
+template <typename T>
+inline std::enable_if_t<!std::is_integral<T>::value>
+atomic_add(std::atomic<T>& a, T x,
+  std::memory_order order = std::memory_order_relaxed
+) noexcept {
+  T old = a.load(std::memory_order_relaxed);
+  while (!a.compare_exchange_weak(old, old+x,
+    order, std::memory_order_relaxed)) ;
+}
+
+// Counting bin ======================================================
+
+template <typename T = unsigned long>
+struct atomic_count {
+  using value_type = T;
+  std::atomic<T> n;
+
+  atomic_count(T n = 0) noexcept: n(n) { }
+  atomic_count(const atomic_count& o) noexcept: n(o.get()) { }
+  atomic_count& operator=(const atomic_count& o) noexcept {
+    n.store(o.get(),std::memory_order_relaxed);
+    return *this;
+  }
+
+  inline void fill(std::memory_order order) noexcept
+  { atomic_add(n,T(1),order); }
+
+  atomic_count& operator++() noexcept {
+    fill(std::memory_order_relaxed);
+    return *this;
+  }
+  atomic_count& operator+=(const atomic_count& o) noexcept {
+    atomic_add(n,o.get());
+    return *this;
+  }
+
+  inline T get() const noexcept { return n.load(std::memory_order_relaxed); }
+  inline operator T() const noexcept { return get(); }
+};
+
+// Weighted bin =====================================================
+
+template <typename T = double, typename N = unsigned long>
+struct atomic_weight {
+  using value_type = T;
+  std::atomic<T> w, w2;
+  std::atomic<N> n;
+
+  atomic_weight() noexcept: w(0), w2(0), n(0) { }
+  atomic_weight(const atomic_weight& o) noexcept
+  : w(o.w.load(std::memory_order_relaxed)),
+    w2(o.w2.load(std::memory_order_relaxed)),
+    n(o.n.load(std::memory_order_relaxed)) { }
+  atomic_weight& operator=(const atomic_weight& o) noexcept {
+    w .store(o.w .load(std::memory_order_relaxed),std::memory_order_relaxed);
+    w2.store(o.w2.load(std::memory_order_relaxed),std::memory_order_relaxed);
+    n .store(o.n .load(std::memory_order_relaxed),std::memory_order_relaxed);
+    return *this;
+  }
+
+  inline void fill(std::memory_order order, T weight) noexcept {
+    atomic_add(w,weight,order);
+    atomic_add(w2,weight*weight,order);
+    atomic_add(n,N(1),order);
+  }
+  inline void fill(std::memory_order order) noexcept { fill(order,T(1)); }
+
+  atomic_weight& operator()(T weight) noexcept {
+    fill(std::memory_order_relaxed,weight);
+    return *this;
+  }
+  atomic_weight& operator()() noexcept { return (*this)(T(1)); }
+
+  atomic_weight& operator+=(const atomic_weight& o) noexcept {
+    atomic_add(w ,o.w .load(std::memory_order_relaxed));
+    atomic_add(w2,o.w2.load(std::memory_order_relaxed));
+    atomic_add(n ,o.n .load(std::memory_order_relaxed));
+    return *this;
+  }
+};
+
+// Padding ==========================================================
+
+// Gives each bin its own cache line to avoid false sharing
+// between threads filling neighbouring bins.
+// Over-aligned vector elements need C++17 aligned new.
+template <typename Bin>
+struct alignas(IVANP_CACHE_LINE) padded_bin: Bin {
+  using bin_type = Bin;
+  using Bin::Bin;
+  padded_bin() = default;
+  padded_bin(const Bin& b): Bin(b) { }
+};
+
+// Filler ===========================================================
+
+template <typename Bin,
+          std::memory_order Order = std::memory_order_relaxed>
+struct atomic_bin_filler {
+  template <typename... Args>
+  static void fill(Bin& bin, Args&&... args) noexcept {
+    bin.fill(Order,std::forward<Args>(args)...);
+  }
+};
+
+} // end namespace ivanp
+
+#endif
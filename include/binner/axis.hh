@@ -10,8 +10,13 @@
 #include <vector>
 #include <memory>
 #include <limits>
+#include <array>
 
 #include "ivanp/tuple_for_each.hh"
+#include "ivanp/unfold.hh"
+#include "ivanp/binner/fwd/axis.hh"
+#include "ivanp/binner/axis_simd.hh"
+#include "ivanp/binner/edge_lut.hh"
 
 // TODO:
 // - keep only container, uniform, and abstract axes
@@ -27,8 +32,6 @@
 
 namespace ivanp {
 
-using axis_size_type = unsigned;
-
 template <typename T>
 class edge_proxy {
 public:
@@ -94,6 +97,15 @@ public:
   virtual size_type vfind_bin(edge_type x) const = 0;
   inline  size_type  find_bin(edge_type x) const { return vfind_bin(x); }
 
+  // one virtual call per batch of values
+  virtual void vfind_bins(
+    size_type n, const edge_type* x, size_type* bins
+  ) const {
+    for (size_type i=0; i<n; ++i) bins[i] = vfind_bin(x[i]);
+  }
+  inline void find_bins(size_type n, const edge_type* x, size_type* bins)
+  const { vfind_bins(n,x,bins); }
+
   virtual edge_type edge(size_type i) const = 0;
   virtual edge_type min() const = 0;
   virtual edge_type max() const = 0;
@@ -130,10 +142,11 @@ struct axis_base { };
 
 // Container Axis ===================================================
 
-template <typename Container, bool Inherit=false>
+template <typename Container, bool Inherit=false, bool Lut=false>
 class container_axis final: public std::conditional_t<Inherit,
   abstract_axis<typename std::decay_t<Container>::value_type>,
-  axis_base>
+  axis_base>,
+  edge_lut_t<typename std::decay_t<Container>::value_type,Lut>
 {
 public:
   using base_type = std::conditional_t<Inherit,
@@ -143,56 +156,72 @@ public:
   using edge_type = typename std::decay_t<container_type>::value_type;
   using edge_ptype = edge_proxy<edge_type>;
   using size_type = ivanp::axis_size_type;
+  using lut_type = edge_lut_t<edge_type,Lut>;
 
 private:
   container_type _edges;
 
+  // the lookup table is a base, so that no_edge_lut takes no space
+  inline lut_type& lut() noexcept { return *this; }
+  inline const lut_type& lut() const noexcept { return *this; }
+
 public:
   container_axis() = default;
   ~container_axis() = default;
 
-  container_axis(const container_type& edges): _edges(edges) { }
+  container_axis(const container_type& edges)
+  : lut_type(edges), _edges(edges) { }
   template <typename C=container_type,
             std::enable_if_t<!std::is_reference<C>::value>* = nullptr>
-  container_axis(container_type&& edges): _edges(std::move(edges)) { }
+  container_axis(container_type&& edges)
+  : lut_type(edges), _edges(std::move(edges)) { }
 
-  container_axis(const container_axis& axis): _edges(axis._edges) { }
+  container_axis(const container_axis& axis)
+  : base_type(axis), lut_type(axis.lut()), _edges(axis._edges) { }
   template <typename C=container_type,
             std::enable_if_t<!std::is_reference<C>::value>* = nullptr>
-  container_axis(container_axis&& axis): _edges(std::move(axis._edges)) { }
+  container_axis(container_axis&& axis)
+  : base_type(std::move(axis)), lut_type(std::move(axis.lut())),
+    _edges(std::move(axis._edges)) { }
 
   template <typename C=container_type,
             std::enable_if_t<std::is_constructible<
               C, std::initializer_list<edge_type>
             >::value>* = nullptr>
-  container_axis(std::initializer_list<edge_type> edges): _edges(edges) { }
+  container_axis(std::initializer_list<edge_type> edges)
+  : lut_type(edges.begin(),edges.size()), _edges(edges) { }
   template <typename C=container_type,
             std::enable_if_t<!std::is_constructible<
               C, std::initializer_list<edge_type>
             >::value>* = nullptr>
   container_axis(std::initializer_list<edge_type> edges) {
     std::copy(edges.begin(),edges.end(),_edges.begin());
+    lut() = lut_type(_edges);
   }
 
   container_axis& operator=(const container_type& edges) {
     _edges = edges;
+    lut() = lut_type(_edges);
     return *this;
   }
   template <typename C=container_type,
             std::enable_if_t<!std::is_reference<C>::value>* = nullptr>
   container_axis& operator=(container_type&& edges) {
     _edges = std::move(edges);
+    lut() = lut_type(_edges);
     return *this;
   }
 
   container_axis& operator=(const container_axis& axis) {
     _edges = axis._edges;
+    lut() = axis.lut();
     return *this;
   }
   template <typename C=container_type,
             std::enable_if_t<!std::is_reference<C>::value>* = nullptr>
   container_axis& operator=(container_axis&& axis) {
     _edges = std::move(axis._edges);
+    lut() = std::move(axis.lut());
     return *this;
   }
 
@@ -221,14 +250,25 @@ public:
     return proxy;
   }
 
-  template <typename T>
-  size_type find_bin(const T& x) const noexcept {
+  template <typename T, bool L = Lut>
+  std::enable_if_t<!L,size_type> find_bin(const T& x) const noexcept {
     return std::distance(
       _edges.begin(), std::upper_bound(_edges.begin(), _edges.end(), x)
     );
   }
+  template <typename T, bool L = Lut>
+  std::enable_if_t< L,size_type> find_bin(const T& x) const noexcept {
+    return lut().find(_edges.data(),x);
+  }
   inline size_type vfind_bin(edge_type x) const { return find_bin(x); }
 
+  template <typename T>
+  void find_bins(size_type n, const T* x, size_type* bins) const noexcept {
+    for (size_type i=0; i<n; ++i) bins[i] = find_bin(x[i]);
+  }
+  inline void vfind_bins(size_type n, const edge_type* x, size_type* bins)
+  const noexcept { find_bins(n,x,bins); }
+
   template <typename T>
   inline size_type operator[](const T& x) const noexcept {
     return find_bin(x);
@@ -252,22 +292,40 @@ public:
   using edge_type = EdgeType;
   using edge_ptype = edge_proxy<edge_type>;
   using size_type = ivanp::axis_size_type;
+  using scale_type = std::conditional_t<
+    std::is_floating_point<edge_type>::value, edge_type, double>;
 
 private:
   size_type _nbins;
   edge_type _min, _max;
+  scale_type _scale; // nbins/(max-min)
+
+  template <typename T, typename E = edge_type>
+  inline std::enable_if_t<std::is_floating_point<E>::value,size_type>
+  find_bin_in_range(const T& x) const noexcept {
+    const size_type i = (x-_min)*_scale;
+    return (i < _nbins ? i : _nbins-1) + 1;
+  }
+  template <typename T, typename E = edge_type>
+  inline std::enable_if_t<!std::is_floating_point<E>::value,size_type>
+  find_bin_in_range(const T& x) const noexcept {
+    return _nbins*(x-_min)/(_max-_min) + 1;
+  }
 
 public:
   uniform_axis() = default;
   ~uniform_axis() = default;
   uniform_axis(size_type nbins, edge_type min, edge_type max)
-  : _nbins(nbins), _min(std::min(min,max)), _max(std::max(min,max)) { }
+  : _nbins(nbins), _min(std::min(min,max)), _max(std::max(min,max)),
+    _scale(scale_type(_nbins)/(_max-_min)) { }
   uniform_axis(const uniform_axis& axis)
-  : _nbins(axis._nbins), _min(axis._min), _max(axis._max) { }
+  : _nbins(axis._nbins), _min(axis._min), _max(axis._max),
+    _scale(axis._scale) { }
   uniform_axis& operator=(const uniform_axis& axis) {
     _nbins = axis._nbins;
     _min = axis._min;
     _max = axis._max;
+    _scale = axis._scale;
     return *this;
   }
 
@@ -299,9 +357,17 @@ public:
   size_type find_bin(const T& x) const noexcept {
     if (x < _min) return 0;
     if (!(x < _max)) return _nbins+1;
-    return _nbins*(x-_min)/(_max-_min) + 1;
+    return find_bin_in_range(x);
   }
 
+  template <typename T>
+  void find_bins(size_type n, const T* x, size_type* bins) const noexcept {
+    size_type k = simd::uniform_bins(n,x,bins,_min,_max,_scale,_nbins);
+    for (; k<n; ++k) bins[k] = find_bin(x[k]);
+  }
+  inline void vfind_bins(size_type n, const edge_type* x, size_type* bins)
+  const noexcept { find_bins(n,x,bins); }
+
   inline size_type vfind_bin(edge_type x) const noexcept
   { return find_bin(x); }
 
@@ -371,6 +437,14 @@ public:
     return x-_min+1;
   }
 
+  template <typename T>
+  void find_bins(size_type n, const T* x, size_type* bins) const noexcept {
+    size_type k = simd::index_bins(n,x,bins,_min,_max);
+    for (; k<n; ++k) bins[k] = find_bin(x[k]);
+  }
+  inline void vfind_bins(size_type n, const edge_type* x, size_type* bins)
+  const noexcept { find_bins(n,x,bins); }
+
   constexpr size_type vfind_bin(edge_type x) const noexcept
   { return find_bin(x); }
 
@@ -429,6 +503,12 @@ public:
   inline size_type  find_bin (edge_type x) const { return _ref->vfind_bin(x); }
   inline size_type operator[](edge_type x) const { return _ref->vfind_bin(x); }
 
+  // batches are passed through in a single virtual call
+  inline void  find_bins(size_type n, const edge_type* x, size_type* bins)
+  const { _ref->vfind_bins(n,x,bins); }
+  inline void vfind_bins(size_type n, const edge_type* x, size_type* bins)
+  const { _ref->vfind_bins(n,x,bins); }
+
   inline edge_type edge(size_type i) const { return _ref->edge(i); }
   inline edge_type min() const { return _ref->min(); }
   inline edge_type max() const { return _ref->max(); }
@@ -511,9 +591,9 @@ inline decltype(auto) make_shared_axis(const std::array<T,N>& edges) {
 
 // Constexpr Axis ===================================================
 
-template <typename EdgeType, bool Inherit=false>
+template <typename EdgeType, bool Inherit=false, bool Lut=false>
 class const_axis final: public std::conditional_t<Inherit,
-  abstract_axis<EdgeType>, axis_base>
+  abstract_axis<EdgeType>, axis_base>, edge_lut_t<EdgeType,Lut>
 {
 public:
   using base_type = std::conditional_t<Inherit,
@@ -521,14 +601,19 @@ public:
   using edge_type = EdgeType;
   using edge_ptype = edge_proxy<edge_type>;
   using size_type = ivanp::axis_size_type;
+  using lut_type = edge_lut_t<edge_type,Lut>;
 
 private:
   const edge_type* _edges;
   size_type _ne;
 
+  // the lookup table is a base, so that no_edge_lut takes no space
+  inline const lut_type& lut() const noexcept { return *this; }
+
 public:
   template <size_type N>
-  constexpr const_axis(const edge_type(&a)[N]): _edges(a), _ne(N - 1) {}
+  constexpr const_axis(const edge_type(&a)[N])
+  : lut_type(a, N), _edges(a), _ne(N - 1) {}
 
   constexpr size_type nedges() const noexcept { return _ne+1; }
   constexpr size_type nbins () const noexcept { return _ne; }
@@ -551,7 +636,9 @@ public:
     return proxy;
   }
 
-  constexpr size_type find_bin(edge_type x) const noexcept {
+  template <bool L = Lut>
+  constexpr std::enable_if_t<!L,size_type>
+  find_bin(edge_type x) const noexcept {
     size_type i = 0, j = 0, count = _ne, step = 0;
 
     if (!(x < _edges[_ne])) i = _ne + 1;
@@ -565,17 +652,129 @@ public:
     }
     return i;
   }
+  template <bool L = Lut>
+  inline std::enable_if_t< L,size_type>
+  find_bin(edge_type x) const noexcept { return lut().find(_edges,x); }
+
   constexpr size_type operator[](edge_type x) const noexcept
   { return find_bin(x); }
   inline size_type vfind_bin(edge_type x) const noexcept
   { return find_bin(x); }
+  inline void vfind_bins(size_type n, const edge_type* x, size_type* bins)
+  const noexcept { for (size_type i=0; i<n; ++i) bins[i] = find_bin(x[i]); }
 
   constexpr bool is_uniform() const noexcept { return false; }
 
 };
 
+// Static Axis ======================================================
+
+#ifndef IVANP_STATIC_AXIS_LINEAR_MAX
+#define IVANP_STATIC_AXIS_LINEAR_MAX 16
+#endif
+
+template <typename EdgeType, size_t N, bool Inherit=false>
+class static_axis final: public std::conditional_t<Inherit,
+  abstract_axis<EdgeType>, axis_base>
+{
+  static_assert(N > 1,"static_axis needs at least 2 edges");
+public:
+  using base_type = std::conditional_t<Inherit,
+    abstract_axis<EdgeType>, axis_base>;
+  using edge_type = EdgeType;
+  using edge_ptype = edge_proxy<edge_type>;
+  using size_type = ivanp::axis_size_type;
+  using container_type = std::array<edge_type,N>;
+
+private:
+  container_type _edges;
+
+  template <size_t... I>
+  constexpr static_axis(const edge_type(&a)[N], std::index_sequence<I...>)
+  : _edges{{a[I]...}} { }
+
+  // branchless linear scan, unrolled
+  template <size_t... I>
+  constexpr size_type count_le(edge_type x, std::index_sequence<I...>)
+  const noexcept {
+    size_type n = 0;
+    UNFOLD( n += !(x < std::get<I>(_edges)) )
+    return n;
+  }
+
+  // branchless binary search, length known at compile time
+  template <size_t Len>
+  constexpr std::enable_if_t<(Len>1),size_type>
+  search(edge_type x, size_type i) const noexcept {
+    return search<Len-Len/2>(x, (x < _edges[i+Len/2]) ? i : i+Len/2);
+  }
+  template <size_t Len>
+  constexpr std::enable_if_t<(Len==1),size_type>
+  search(edge_type x, size_type i) const noexcept {
+    return i + !(x < _edges[i]);
+  }
+
+public:
+  constexpr static_axis(const edge_type(&a)[N])
+  : static_axis(a,std::make_index_sequence<N>{}) { }
+  constexpr static_axis(const container_type& a): _edges(a) { }
+
+  static constexpr size_type nedges() noexcept { return N; }
+  static constexpr size_type nbins () noexcept { return N-1; }
+
+  constexpr edge_type edge(size_type i) const noexcept { return _edges[i]; }
+
+  constexpr edge_type min() const noexcept { return _edges[0]; }
+  constexpr edge_type max() const noexcept { return _edges[N-1]; }
+
+  inline edge_ptype lower(size_type i) const noexcept {
+    edge_ptype proxy(
+      i==0 ? edge_ptype::minf :
+      i>nedges()+1 ? edge_ptype::pinf : edge_ptype::ok );
+    if (proxy) proxy = edge(i-1);
+    return proxy;
+  }
+  inline edge_ptype upper(size_type i) const noexcept {
+    edge_ptype proxy( i>=nedges() ? edge_ptype::pinf : edge_ptype::ok );
+    if (proxy) proxy = edge(i);
+    return proxy;
+  }
+
+  template <size_t M = N>
+  constexpr std::enable_if_t<(M<=IVANP_STATIC_AXIS_LINEAR_MAX),size_type>
+  find_bin(edge_type x) const noexcept {
+    return count_le(x,std::make_index_sequence<N>{});
+  }
+  template <size_t M = N>
+  constexpr std::enable_if_t<(M>IVANP_STATIC_AXIS_LINEAR_MAX),size_type>
+  find_bin(edge_type x) const noexcept {
+    return search<N>(x,0);
+  }
+  constexpr size_type operator[](edge_type x) const noexcept
+  { return find_bin(x); }
+  inline size_type vfind_bin(edge_type x) const noexcept
+  { return find_bin(x); }
+  inline void vfind_bins(size_type n, const edge_type* x, size_type* bins)
+  const noexcept { for (size_type i=0; i<n; ++i) bins[i] = find_bin(x[i]); }
+
+  constexpr const container_type& edges() const noexcept { return _edges; }
+
+  constexpr bool is_uniform() const noexcept { return false; }
+
+};
+
+template <typename T, size_t N>
+constexpr static_axis<T,N> make_static_axis(const T(&edges)[N]) {
+  return { edges };
+}
+
 // ==================================================================
 
+// Concatenation of axes.
+// At construction, the boundaries of all sub-axes are merged into one
+// sorted array of breakpoints, so find_bin is a single search.
+// Uniform sub-axes contribute only their ends and are resolved
+// arithmetically. The sub-axes must not be modified afterwards.
 template <typename... Axes>
 class union_axis {
 public:
@@ -584,63 +783,179 @@ public:
   using edge_type = std::common_type_t<typename Axes::edge_type...>;
   using edge_ptype = edge_proxy<edge_type>;
 
-  union_axis(Axes&&... axes): axes{ std::forward<Axes>(axes)... } { }
+private:
+  // interval between consecutive breakpoints
+  struct interval {
+    enum kind_type : char { flat, scaled, ratio };
+    kind_type kind;
+    size_type base, n;
+    edge_type lo, a; // a is nbins/(max-min) if scaled, max-min if ratio
+  };
 
-  size_type nbins() const {
-    size_type n = 0;
-    for_each(axes,[&n](const auto& a){ n += a.nbins(); });
-    return n;
-  }
-  size_type nedges() const {
-    size_type n = 0;
-    for_each(axes,[&n](const auto& a){ n += a.nedges(); });
-    return n;
+  std::vector<edge_type> _breaks;
+  std::vector<interval> _intervals; // one more than breaks
+  std::array<size_type,sizeof...(Axes)+1> _nbins_before, _nedges_before;
+
+  // the same arithmetic as in uniform_axis::find_bin
+  template <typename A>
+  static std::enable_if_t<
+    std::is_floating_point<typename A::edge_type>::value, interval>
+  uniform_interval(const A& a, size_type base) noexcept {
+    using scale_type = typename A::edge_type;
+    return { interval::scaled, base, a.nbins(), edge_type(a.min()),
+      edge_type(scale_type(a.nbins())/(a.max()-a.min())) };
+  }
+  template <typename A>
+  static std::enable_if_t<
+    !std::is_floating_point<typename A::edge_type>::value, interval>
+  uniform_interval(const A& a, size_type base) noexcept {
+    return { interval::ratio, base, a.nbins(), edge_type(a.min()),
+      edge_type(a.max()-a.min()) };
+  }
+
+  void add_interval(size_type base) {
+    _intervals.push_back({ interval::flat, base, 0, edge_type{}, edge_type{} });
+  }
+
+  // Same semantics as walking the sub-axes in order:
+  // the first sub-axis whose max is above x gives the bin,
+  // x below its min, including gaps between sub-axes, is underflow.
+  template <typename A>
+  void merge(const A& axis, size_type& off, bool& first, edge_type& prev) {
+    const size_type n = axis.nbins();
+    const edge_type m = axis.min(), M = axis.max();
+    const edge_type lo = first ? m : std::max(prev,m);
+    if (!(lo < M)) { off += n; return; } // fully covered by earlier axes
+    if (first || prev < m) {
+      if (!first) add_interval(0); // gap
+      _breaks.push_back(m);
+    }
+    if (axis.is_uniform()) {
+      _intervals.push_back(uniform_interval(axis,off));
+    } else {
+      const size_type ne = axis.nedges();
+      size_type i = 0;
+      while (i < ne && !(lo < edge_type(axis.edge(i)))) ++i;
+      add_interval(off + i);
+      for (; i < ne-1; ++i) {
+        _breaks.push_back(axis.edge(i));
+        add_interval(off + i + 1);
+      }
+    }
+    _breaks.push_back(M);
+    off += n;
+    first = false;
+    prev = M;
+  }
+
+  void build() {
+    size_type k = 0, off = 0;
+    bool first = true;
+    edge_type prev { };
+    _nbins_before[0] = _nedges_before[0] = 0;
+    _intervals.clear();
+    _breaks.clear();
+    add_interval(0); // underflow
+    for_each(axes,[&](const auto& a){
+      merge(a,off,first,prev);
+      _nbins_before [k+1] = _nbins_before [k] + a.nbins ();
+      _nedges_before[k+1] = _nedges_before[k] + a.nedges();
+      ++k;
+    });
+    add_interval(off+1); // overflow
+  }
+
+  // calls f on the k-th sub-axis through a jump table
+  template <size_t I, typename R, typename F>
+  static R call(const std::tuple<Axes...>& t, F& f) {
+    return f(std::get<I>(t));
+  }
+  template <typename F, size_t... I>
+  decltype(auto) visit(size_type k, F&& f, std::index_sequence<I...>) const {
+    using R = decltype(f(std::get<0>(axes)));
+    using fcn = R(*)(const std::tuple<Axes...>&, F&);
+    static constexpr fcn table[] = { &call<I,R,F>... };
+    return table[k](axes,f);
+  }
+  template <typename F>
+  decltype(auto) visit(size_type k, F&& f) const {
+    return visit(k,f,std::index_sequence_for<Axes...>{});
+  }
+
+  // sub-axis k such that p[k] <= i < p[k+1], or the number of axes
+  template <typename P>
+  static size_type segment(const P& p, size_type i) noexcept {
+    return std::upper_bound(p.begin()+1, p.end(), i) - (p.begin()+1);
   }
 
-  size_type find_bin(edge_type x) const {
-    size_type i = 0;
-    if (!for_each(axes,[&](const auto& a){
-      size_type j = a.find_bin(x);
-      if (j==0) { i = 0; return true; }
-      const auto n = a.nbins();
-      if (j<n+1) { i += j; return true; }
-      i += n; return false;
-    })) ++i;
-    return i;
+public:
+  union_axis(Axes&&... axes): axes{ std::forward<Axes>(axes)... } { build(); }
+
+  size_type nbins () const noexcept { return _nbins_before .back(); }
+  size_type nedges() const noexcept { return _nedges_before.back(); }
+
+  size_type find_bin(edge_type x) const noexcept {
+    // branchless upper_bound
+    const edge_type* base = _breaks.data();
+    size_type n = _breaks.size();
+    while (n > 1) {
+      const size_type half = n/2;
+      base = (x < base[half]) ? base : base+half;
+      n -= half;
+    }
+    const interval& v = _intervals[(base-_breaks.data()) + !(x < *base)];
+    switch (v.kind) {
+      case interval::scaled: {
+        const size_type i = (x-v.lo)*v.a;
+        return v.base + (i < v.n ? i : v.n-1) + 1;
+      }
+      case interval::ratio: return v.base + v.n*(x-v.lo)/v.a + 1;
+      default: return v.base;
+    }
   }
   size_type vfind_bin(edge_type x) const { return find_bin(x); }
+  template <typename T>
+  void find_bins(size_type n, const T* x, size_type* bins) const noexcept {
+    for (size_type i=0; i<n; ++i) bins[i] = find_bin(x[i]);
+  }
+  void vfind_bins(size_type n, const edge_type* x, size_type* bins) const {
+    find_bins(n,x,bins);
+  }
 
+  // sub-axes edges are counted separately, as in nedges()
   edge_type edge(size_type i) const {
-    edge_type e;
-    if (for_each(axes,[&](const auto& a){
-      const auto n = a.nedges();
-      if (i<n) { e = a.edge(i); return true; }
-      i -= n; return false;
-    })) return e;
-    return max();
+    const size_type k = segment(_nedges_before,i);
+    if (k == sizeof...(Axes)) return max();
+    i -= _nedges_before[k];
+    return visit(k,[i](const auto& a) -> edge_type { return a.edge(i); });
   }
   edge_type min() const { return std::get<0>(axes).min(); }
   edge_type max() const { return std::get<sizeof...(Axes)-1>(axes).max(); }
   edge_ptype lower(size_type i) const {
     if (i==0) return edge_ptype::minf;
-    size_type n;
+    const size_type k = segment(_nbins_before,i-1);
     edge_ptype edge;
-    if (!for_each(axes,[&](const auto& a){
-      n = a.nbins();
-      if (i<=n) { edge = a.lower(i); return true; }
-      i -= n; return false;
-    })) edge = max();
+    if (k == sizeof...(Axes)) edge = max();
+    else {
+      i -= _nbins_before[k];
+      edge = visit(k,[i](const auto& a){
+        edge_ptype e;
+        e = a.lower(i);
+        return e;
+      });
+    }
     return edge;
   }
   edge_ptype upper(size_type i) const {
     if (i==0) return std::get<0>(axes).upper(0);
-    edge_ptype edge;
-    if (!for_each(axes,[&](const auto& a){
-      const auto n = a.nbins();
-      if (i<=n) { edge = a.upper(i); return true; }
-      i -= n; return false;
-    })) return edge_ptype::pinf;
-    return edge;
+    const size_type k = segment(_nbins_before,i-1);
+    if (k == sizeof...(Axes)) return edge_ptype::pinf;
+    i -= _nbins_before[k];
+    return visit(k,[i](const auto& a){
+      edge_ptype e;
+      e = a.upper(i);
+      return e;
+    });
   }
 
   constexpr bool is_uniform() const { return false; }
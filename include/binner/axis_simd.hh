@@ -0,0 +1,215 @@
+#ifndef IVANP_AXIS_SIMD_HH
+#define IVANP_AXIS_SIMD_HH
+
+// Batch bin lookup kernels for uniform_axis and index_axis.
+// Code path is selected at runtime: AVX2, SSE2, or scalar.
+// Kernels process whole vectors only and return the number of values done;
+// the caller finishes the tail with the scalar find_bin.
+
+#include <climits>
+#include <type_traits>
+
+#include "ivanp/binner/fwd/axis.hh"
+
+#if !defined(IVANP_AXIS_NO_SIMD) \
+  && (defined(__x86_64__) || defined(__i386__)) \
+  && (defined(__GNUC__) || defined(__clang__))
+#define IVANP_AXIS_SIMD
+#include <immintrin.h>
+#endif
+
+namespace ivanp {
+namespace simd {
+
+enum level : char { scalar = 0, sse = 1, avx2 = 2 };
+
+inline level detect_level() noexcept {
+#ifdef IVANP_AXIS_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return avx2;
+  if (__builtin_cpu_supports("sse2")) return sse;
+#endif
+  return scalar;
+}
+
+// can be lowered to force a particular code path
+inline level& active_level() noexcept {
+  static level l = detect_level();
+  return l;
+}
+
+#ifdef IVANP_AXIS_SIMD
+namespace detail {
+
+// uniform ----------------------------------------------------------
+// d = (x-min)*scale clamped to [0,nbins-1],
+// then set to -1 for underflow and nbins for overflow (incl. NaN),
+// so that truncation + 1 gives the bin number.
+// Truncation is to int32, so nbins must not exceed INT_MAX
+
+__attribute__((target("avx2")))
+inline axis_size_type uniform_bins_avx2(
+  axis_size_type n, const double* x, axis_size_type* b,
+  double min, double max, double scale, axis_size_type nbins
+) noexcept {
+  const __m256d vmin   = _mm256_set1_pd(min),
+                vmax   = _mm256_set1_pd(max),
+                vscale = _mm256_set1_pd(scale),
+                vzero  = _mm256_setzero_pd(),
+                vlast  = _mm256_set1_pd(nbins-1),
+                vunder = _mm256_set1_pd(-1),
+                vover  = _mm256_set1_pd(nbins);
+  const __m128i vone = _mm_set1_epi32(1);
+  axis_size_type k = 0;
+  for (; k+4<=n; k+=4) {
+    const __m256d v = _mm256_loadu_pd(x+k);
+    __m256d d = _mm256_mul_pd(_mm256_sub_pd(v,vmin),vscale);
+    d = _mm256_min_pd(_mm256_max_pd(d,vzero),vlast);
+    d = _mm256_blendv_pd(d,vunder,_mm256_cmp_pd(v,vmin,_CMP_LT_OQ));
+    d = _mm256_blendv_pd(d,vover ,_mm256_cmp_pd(v,vmax,_CMP_NLT_UQ));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(b+k),
+      _mm_add_epi32(_mm256_cvttpd_epi32(d),vone));
+  }
+  return k;
+}
+
+__attribute__((target("sse2")))
+inline axis_size_type uniform_bins_sse(
+  axis_size_type n, const double* x, axis_size_type* b,
+  double min, double max, double scale, axis_size_type nbins
+) noexcept {
+  const __m128d vmin   = _mm_set1_pd(min),
+                vmax   = _mm_set1_pd(max),
+                vscale = _mm_set1_pd(scale),
+                vzero  = _mm_setzero_pd(),
+                vlast  = _mm_set1_pd(nbins-1),
+                vunder = _mm_set1_pd(-1),
+                vover  = _mm_set1_pd(nbins);
+  const __m128i vone = _mm_set1_epi32(1);
+  axis_size_type k = 0;
+  for (; k+2<=n; k+=2) {
+    const __m128d v = _mm_loadu_pd(x+k);
+    __m128d d = _mm_mul_pd(_mm_sub_pd(v,vmin),vscale);
+    d = _mm_min_pd(_mm_max_pd(d,vzero),vlast);
+    const __m128d u = _mm_cmplt_pd(v,vmin);
+    d = _mm_or_pd(_mm_andnot_pd(u,d),_mm_and_pd(u,vunder));
+    const __m128d o = _mm_cmpnlt_pd(v,vmax);
+    d = _mm_or_pd(_mm_andnot_pd(o,d),_mm_and_pd(o,vover));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(b+k),
+      _mm_add_epi32(_mm_cvttpd_epi32(d),vone));
+  }
+  return k;
+}
+
+// index ------------------------------------------------------------
+// bias flips the sign bit so that unsigned values compare as signed
+
+__attribute__((target("avx2")))
+inline axis_size_type index_bins_avx2(
+  axis_size_type n, const void* x, axis_size_type* b,
+  int min, int max, int bias
+) noexcept {
+  const __m256i vbias = _mm256_set1_epi32(bias),
+                vmin  = _mm256_set1_epi32(min),
+                vmax  = _mm256_set1_epi32(max),
+                bmin  = _mm256_xor_si256(vmin,vbias),
+                bmax  = _mm256_xor_si256(vmax,vbias),
+                vone  = _mm256_set1_epi32(1),
+                vover = _mm256_set1_epi32(int(unsigned(max)-unsigned(min)+1u));
+  const __m256i* p = reinterpret_cast<const __m256i*>(x);
+  axis_size_type k = 0;
+  for (; k+8<=n; k+=8, ++p) {
+    const __m256i v  = _mm256_loadu_si256(p);
+    const __m256i bv = _mm256_xor_si256(v,vbias);
+    __m256i r = _mm256_add_epi32(_mm256_sub_epi32(v,vmin),vone);
+    r = _mm256_blendv_epi8(vover,r,_mm256_cmpgt_epi32(bmax,bv));
+    r = _mm256_andnot_si256(_mm256_cmpgt_epi32(bmin,bv),r);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(b+k),r);
+  }
+  return k;
+}
+
+__attribute__((target("sse2")))
+inline axis_size_type index_bins_sse(
+  axis_size_type n, const void* x, axis_size_type* b,
+  int min, int max, int bias
+) noexcept {
+  const __m128i vbias = _mm_set1_epi32(bias),
+                vmin  = _mm_set1_epi32(min),
+                vmax  = _mm_set1_epi32(max),
+                bmin  = _mm_xor_si128(vmin,vbias),
+                bmax  = _mm_xor_si128(vmax,vbias),
+                vone  = _mm_set1_epi32(1),
+                vover = _mm_set1_epi32(int(unsigned(max)-unsigned(min)+1u));
+  const __m128i* p = reinterpret_cast<const __m128i*>(x);
+  axis_size_type k = 0;
+  for (; k+4<=n; k+=4, ++p) {
+    const __m128i v  = _mm_loadu_si128(p);
+    const __m128i bv = _mm_xor_si128(v,vbias);
+    __m128i r = _mm_add_epi32(_mm_sub_epi32(v,vmin),vone);
+    const __m128i in = _mm_cmpgt_epi32(bmax,bv);
+    r = _mm_or_si128(_mm_and_si128(in,r),_mm_andnot_si128(in,vover));
+    r = _mm_andnot_si128(_mm_cmpgt_epi32(bmin,bv),r);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(b+k),r);
+  }
+  return k;
+}
+
+} // end namespace detail
+#endif
+
+// uniform_bins -----------------------------------------------------
+template <typename T, typename E, typename S>
+inline axis_size_type uniform_bins(
+  axis_size_type, const T*, axis_size_type*, E, E, S, axis_size_type
+) noexcept { return 0; }
+
+inline axis_size_type uniform_bins(
+  axis_size_type n, const double* x, axis_size_type* b,
+  double min, double max, double scale, axis_size_type nbins
+) noexcept {
+#ifdef IVANP_AXIS_SIMD
+  if (nbins > axis_size_type(INT_MAX)) return 0;
+  switch (active_level()) {
+    case avx2: return detail::uniform_bins_avx2(n,x,b,min,max,scale,nbins);
+    case sse : return detail::uniform_bins_sse (n,x,b,min,max,scale,nbins);
+    default  : break;
+  }
+#endif
+  return 0;
+}
+
+// index_bins -------------------------------------------------------
+template <typename T, typename E>
+inline std::enable_if_t<
+  !(sizeof(T)==4 && sizeof(E)==4 &&
+    std::is_integral<T>::value && std::is_integral<E>::value),
+  axis_size_type>
+index_bins(axis_size_type, const T*, axis_size_type*, E, E) noexcept
+{ return 0; }
+
+template <typename T, typename E>
+inline std::enable_if_t<
+  (sizeof(T)==4 && sizeof(E)==4 &&
+   std::is_integral<T>::value && std::is_integral<E>::value),
+  axis_size_type>
+index_bins(
+  axis_size_type n, const T* x, axis_size_type* b, E min, E max
+) noexcept {
+#ifdef IVANP_AXIS_SIMD
+  // same as the usual arithmetic conversions in x < min
+  const int bias = std::is_signed<T>::value && std::is_signed<E>::value
+                 ? 0 : int(0x80000000u);
+  switch (active_level()) {
+    case avx2: return detail::index_bins_avx2(n,x,b,min,max,bias);
+    case sse : return detail::index_bins_sse (n,x,b,min,max,bias);
+    default  : break;
+  }
+#endif
+  return 0;
+}
+
+} // end namespace simd
+} // end namespace ivanp
+
+#endif
@@ -7,20 +7,22 @@
 
 namespace ivanp {
 
+// Bin is deduced from the argument, so proxies returned by value
+// from a container's operator[] can be filled too
 template <typename BinType> struct bin_filler {
 
   template <typename Bin = BinType>
   static typename std::enable_if<
     has_pre_increment<Bin>::value
   >::type
-  fill(Bin& bin) noexcept(noexcept(++bin)) { ++bin; }
+  fill(Bin&& bin) noexcept(noexcept(++bin)) { ++bin; }
 
   template <typename Bin = BinType>
   static typename std::enable_if<
     !has_pre_increment<Bin>::value &&
     has_post_increment<Bin>::value
   >::type
-  fill(Bin& bin) noexcept(noexcept(bin++)) { bin++; }
+  fill(Bin&& bin) noexcept(noexcept(bin++)) { bin++; }
 
   template <typename Bin = BinType>
   static typename std::enable_if<
@@ -28,13 +30,13 @@ template <typename BinType> struct bin_filler {
     !has_post_increment<Bin>::value &&
     is_callable<Bin>::value
   >::type
-  fill(Bin& bin) noexcept(noexcept(bin())) { bin(); }
+  fill(Bin&& bin) noexcept(noexcept(bin())) { bin(); }
 
   template <typename T, typename Bin = BinType>
   static typename std::enable_if<
     has_plus_eq<Bin,T>::value
   >::type
-  fill(Bin& bin, T&& x) noexcept(noexcept(bin+=std::forward<T>(x)))
+  fill(Bin&& bin, T&& x) noexcept(noexcept(bin+=std::forward<T>(x)))
   { bin+=std::forward<T>(x); }
 
   template <typename T1, typename... TT, typename Bin = BinType>
@@ -42,7 +44,7 @@ template <typename BinType> struct bin_filler {
     ( !has_plus_eq<Bin,T1>::value || sizeof...(TT) ) &&
     is_callable<Bin,T1,TT...>::value
   >::type
-  fill(Bin& bin, T1&& arg1, TT&&... args)
+  fill(Bin&& bin, T1&& arg1, TT&&... args)
   noexcept(noexcept(bin(std::forward<T1>(arg1), std::forward<TT>(args)...)))
   { bin(std::forward<T1>(arg1), std::forward<TT>(args)...); }
 
@@ -7,12 +7,24 @@
 #include <array>
 #include <vector>
 #include <iterator>
+#include <algorithm>
 #include <stdexcept>
 
 #include "ivanp/binner/axis.hh"
 #include "ivanp/binner/bin_filler.hh"
 #include "ivanp/utility.hh"
 #include "ivanp/seq/seq.hh"
+#include "ivanp/unfold.hh"
+#include "ivanp/detect.hh"
+#include "ivanp/boolean.hh"
+
+#ifndef IVANP_BINNER_BATCH_SIZE
+#define IVANP_BINNER_BATCH_SIZE 1024
+#endif
+
+#ifndef IVANP_BINNER_INTEGRATE_TILE
+#define IVANP_BINNER_INTEGRATE_TILE 256
+#endif
 
 namespace ivanp {
 
@@ -47,16 +59,46 @@ public:
   using container_type = Container;
   using filler = Filler;
   using value_type = typename container_type::value_type;
+private:
+  template <typename C>
+  using detect_const_reference = typename C::const_reference;
+public:
+  // a proxy for struct-of-arrays containers
+  using const_reference = detected_or_t<
+    const value_type&, detect_const_reference, container_type>;
   using size_type = ivanp::axis_size_type;
   static constexpr unsigned naxes = sizeof...(Ax);
   using index_array_type = std::array<size_type,naxes>;
   using index_array_cref = const index_array_type&;
 
+  using any_excep = bool_constant<disjunction<typename Ax::excep...>::value>;
+
   using named_ptr_type = named_ptr<binner>;
   static std::vector<named_ptr_type> all;
 
 private:
   axes_tuple _axes;
+
+  // Products of nbins of the axes before and after each axis,
+  // computed once from the axes.
+  struct strides_type {
+    std::array<size_type,naxes+1> before, after;
+  };
+  template <size_t... I>
+  strides_type make_strides(std::index_sequence<I...>) const noexcept {
+    const std::array<size_type,naxes> n {{ nbins<I>()... }};
+    strides_type s;
+    s.before[0] = 1;
+    for (unsigned i=0; i<naxes; ++i) s.before[i+1] = s.before[i]*n[i];
+    s.after[naxes] = 1;
+    for (unsigned i=naxes; i; --i) s.after[i-1] = s.after[i]*n[i-1];
+    return s;
+  }
+  strides_type make_strides() const noexcept {
+    return make_strides(std::make_index_sequence<naxes>());
+  }
+
+  strides_type _strides; // computed from _axes, must follow it
   container_type _bins;
 
   template <size_t I, typename... Args, size_t... A>
@@ -83,41 +125,24 @@ public:
   }
 
   template <unsigned I> // including I
-  constexpr std::enable_if_t<I!=0,size_type> nbins_left() const noexcept {
-    return nbins<I>() * nbins_left<I-1>();
-  }
-  template <unsigned I> // including I
-  constexpr std::enable_if_t<I==0,size_type> nbins_left() const noexcept {
-    return nbins<I>();
+  constexpr size_type nbins_left() const noexcept {
+    return std::get<I+1>(_strides.before);
   }
   template <unsigned I> // excluding I
-  constexpr std::enable_if_t<I!=0,size_type> nbins_before() const noexcept {
-    return nbins_left<I-1>();
+  constexpr size_type nbins_before() const noexcept {
+    return std::get<I>(_strides.before);
   }
-  template <unsigned I> // excluding I
-  constexpr std::enable_if_t<I==0,size_type> nbins_before() const noexcept {
-    return 1;
-  }
-
   template <unsigned I> // including I
-  constexpr std::enable_if_t<I!=naxes-1,size_type> nbins_right() const noexcept {
-    return nbins<I>() * nbins_right<I+1>();
-  }
-  template <unsigned I> // including I
-  constexpr std::enable_if_t<I==naxes-1,size_type> nbins_right() const noexcept {
-    return nbins<I>();
-  }
-  template <unsigned I> // excluding I
-  constexpr std::enable_if_t<(I<naxes-1),size_type> nbins_after() const noexcept {
-    return nbins_right<I+1>();
+  constexpr size_type nbins_right() const noexcept {
+    return std::get<I>(_strides.after);
   }
   template <unsigned I> // excluding I
-  constexpr std::enable_if_t<(I>=naxes-1),size_type> nbins_after() const noexcept {
-    return 1;
+  constexpr size_type nbins_after() const noexcept {
+    return std::get<(I<naxes ? I+1 : naxes)>(_strides.after);
   }
 
   constexpr size_type nbins_total() const noexcept {
-    return nbins_left<naxes-1>();
+    return std::get<naxes>(_strides.before);
   }
 
   constexpr auto begin() const noexcept { return _bins.begin(); }
@@ -155,22 +180,42 @@ private:
   }
 
   // find_bin_impl --------------------------------------------------
-  template <size_t I=0, typename T, typename... Args>
-  inline size_type find_bin_impl(const T& x, const Args&... args) const {
+  // if any axis throws, axes are searched and checked in order,
+  // so the first out of range axis throws
+  template <size_t I, typename T>
+  inline bool add_bin_index(size_type& i, const T& x) const {
     const size_type bin = axis<I>().find_bin(x);
-    if (guard_under<I>(bin)) return size_type(-1);
-    if (guard_over <I>(bin)) return size_type(-1);
-    const size_type bin1 = find_bin_impl<I+1>(args...);
-    if (bin1 == size_type(-1)) return size_type(-1);
-    return bin - !axis_spec<I>::under::value
-      + (axis<I>().nbins() + axis_spec<I>::nover::value) * bin1;
-  }
-  template <size_t I=0, typename T>
-  inline size_type find_bin_impl(const T& x) const {
-    const size_type bin = axis<I>().find_bin(x);
-    if (guard_under<I>(bin)) return size_type(-1);
-    if (guard_over <I>(bin)) return size_type(-1);
-    return bin - !axis_spec<I>::under::value;
+    if (guard_under<I>(bin) || guard_over<I>(bin)) return true;
+    i += (bin - !axis_spec<I>::under::value) * std::get<I>(_strides.before);
+    return false;
+  }
+  template <typename... T, size_t... I>
+  inline size_type find_bin_impl(
+    std::true_type, std::index_sequence<I...>, const T&... x
+  ) const {
+    size_type i = 0;
+    bool out = false;
+    UNFOLD( out = out || add_bin_index<I>(i,x) )
+    return out ? size_type(-1) : i;
+  }
+  // otherwise, all axes are searched, then checked together
+  template <typename... T, size_t... I>
+  inline size_type find_bin_impl(
+    std::false_type, std::index_sequence<I...>, const T&... x
+  ) const {
+    const index_array_type bins {{ axis<I>().find_bin(x)... }};
+    bool out = false;
+    UNFOLD( out |= guard_under<I>(std::get<I>(bins))
+                 | guard_over <I>(std::get<I>(bins)) )
+    if (out) return size_type(-1);
+    size_type i = 0;
+    UNFOLD( i += (std::get<I>(bins) - !axis_spec<I>::under::value)
+                 * std::get<I>(_strides.before) )
+    return i;
+  }
+  template <typename... T>
+  inline size_type find_bin_impl(const T&... x) const {
+    return find_bin_impl(any_excep(),std::index_sequence_for<T...>(),x...);
   }
   // ----------------------------------------------------------------
   template <typename... T, size_t... I>
@@ -191,64 +236,199 @@ private:
     return bin;
   }
 
-  template <typename T, typename... TT>
-  constexpr size_type index_impl(T i, TT... ii) const noexcept {
-    constexpr auto axis_i = naxes-sizeof...(TT)-1;
-    return i + (axis<axis_i>().nbins()
-             + axis_spec<axis_i>::under::value
-             + axis_spec<axis_i>::over ::value)
-      * index_impl(ii...);
+  // find_bins_impl -------------------------------------------------
+  // one tight loop per axis, accumulating flat indices in ii
+  template <size_t I>
+  inline std::enable_if_t<!axis_spec<I>::excep::value>
+  add_bin_index(size_type bin, size_type stride, size_type& i) const {
+    const bool out = guard_under<I>(bin) | guard_over<I>(bin);
+    const size_type j = i + (bin - !axis_spec<I>::under::value)*stride;
+    i = (out || i==size_type(-1)) ? size_type(-1) : j;
+  }
+  // entries already out on an earlier axis are not checked,
+  // like in fill(), which stops at the first axis out of range
+  template <size_t I>
+  inline std::enable_if_t<axis_spec<I>::excep::value>
+  add_bin_index(size_type bin, size_type stride, size_type& i) const {
+    if (i == size_type(-1)) return;
+    if (guard_under<I>(bin) || guard_over<I>(bin)) i = size_type(-1);
+    else i += (bin - !axis_spec<I>::under::value)*stride;
+  }
+
+  template <typename A, typename T>
+  using detect_find_bins = decltype(std::declval<const A&>().find_bins(
+    size_type(), std::declval<const T*>(), std::declval<size_type*>()));
+
+  template <size_t I, typename T>
+  inline std::enable_if_t<!is_detected<detect_find_bins,axis_type<I>,T>::value>
+  find_bins_axis(size_type n, const T* x, size_type* ii) const {
+    const auto& a = axis<I>();
+    const size_type stride = nbins_before<I>();
+    for (size_type k=0; k<n; ++k)
+      add_bin_index<I>(a.find_bin(x[k]),stride,ii[k]);
+  }
+  template <size_t I, typename T>
+  inline std::enable_if_t<is_detected<detect_find_bins,axis_type<I>,T>::value>
+  find_bins_axis(size_type n, const T* x, size_type* ii) const {
+    // axis provides its own batch lookup
+    const auto& a = axis<I>();
+    const size_type stride = nbins_before<I>();
+    size_type bins[IVANP_BINNER_BATCH_SIZE];
+    for (size_type k=0; k<n; ) {
+      const size_type m = std::min<size_type>(n-k,IVANP_BINNER_BATCH_SIZE);
+      a.find_bins(m,x+k,bins);
+      for (size_type j=0; j<m; ++j, ++k)
+        add_bin_index<I>(bins[j],stride,ii[k]);
+    }
+  }
+  template <typename... T, size_t... I>
+  inline void find_bins_impl(size_type n, size_type* ii,
+    std::index_sequence<I...>, const T*... xs
+  ) const {
+    std::fill_n(ii,n,size_type(0));
+    UNFOLD(( find_bins_axis<I>(n,xs,ii) ))
+  }
+
+  template <typename... T, size_t... I, size_t... A>
+  inline void fill_batch_impl(size_type n, size_type* ii,
+    const std::tuple<const T*...>& t,
+    std::index_sequence<I...>, std::index_sequence<A...>
+  ) {
+    bool thrown = false;
+    try {
+      find_bins_impl(n,ii,std::index_sequence<I...>(),std::get<I>(t)...);
+    } catch (...) {
+      thrown = true;
+    }
+    if (thrown) {
+      // an excep axis threw somewhere in the block, refill it entry by
+      // entry, so that the block throws where and only if fill() would
+      for (size_type k=0; k<n; ++k)
+        fill(std::get<I>(t)[k]..., std::get<A>(t)[k]...);
+      return;
+    }
+    for (size_type k=0; k<n; ++k)
+      if (ii[k] != size_type(-1))
+        filler::fill(_bins[ii[k]], std::get<A>(t)[k]...);
+  }
+
+  template <typename... T, size_t... I>
+  constexpr size_type index_impl(std::index_sequence<I...>, T... ii)
+  const noexcept {
+    size_type i = 0;
+    UNFOLD( i += ii * std::get<I>(_strides.before) )
+    return i;
+  }
+  template <typename... T>
+  constexpr size_type index_impl(T... ii) const noexcept {
+    return index_impl(std::index_sequence_for<T...>(),ii...);
   }
-  constexpr size_type index_impl(size_type i) const noexcept { return i; }
   template <size_t... I>
   constexpr size_type index_impl(index_array_cref ia,std::index_sequence<I...>)
   const noexcept { return index_impl(std::get<I>(ia)...); }
 
 public:
-  binner() = default;
+  binner(): _strides{} { }
   ~binner() = default;
 
   template <typename C=container_type,
             std::enable_if_t<std::is_constructible<
               C, size_type>::value >* = nullptr>
-  binner(typename Ax::axis... axes): _axes{axes...}, _bins(nbins_total()) { }
+  binner(typename Ax::axis... axes)
+  : _axes{axes...}, _strides(make_strides()), _bins(nbins_total()) { }
   template <typename C=container_type,
             std::enable_if_t<!std::is_constructible<
               C, size_type >::value>* = nullptr>
-  binner(typename Ax::axis... axes): _axes{axes...}, _bins{} { }
+  binner(typename Ax::axis... axes)
+  : _axes{axes...}, _strides(make_strides()), _bins{} { }
   template <typename C>
   binner(std::tuple<typename Ax::axis...> axes, C&& bins)
-  : _axes(axes), _bins(std::forward<C>(bins)) { }
+  : _axes(axes), _strides(make_strides()), _bins(std::forward<C>(bins)) { }
 
   template <typename Name>
   binner(Name&& name, typename Ax::axis... axes): binner(axes...) {
     all.emplace_back(this,std::forward<Name>(name));
   }
 
-  binner(const binner& o): _axes(o._axes), _bins(o._bins) { }
-  binner(binner&& o): _axes(std::move(o._axes)), _bins(std::move(o._bins)) { }
+  binner(const binner& o)
+  : _axes(o._axes), _strides(o._strides), _bins(o._bins) { }
+  binner(binner&& o)
+  : _axes(std::move(o._axes)), _strides(o._strides),
+    _bins(std::move(o._bins)) { }
   binner& operator=(const binner& rhs) {
     _axes = rhs._axes;
+    _strides = rhs._strides;
     _bins = rhs._bins;
     return *this;
   }
   binner& operator=(binner&& rhs) {
     _axes = std::move(rhs._axes);
+    _strides = rhs._strides;
     _bins = std::move(rhs._bins);
     return *this;
   }
   binner(const std::string& name, const binner& o)
-  : _axes(o._axes), _bins(o._bins) {
+  : _axes(o._axes), _strides(o._strides), _bins(o._bins) {
     all.emplace_back(this,name);
   }
 
-  binner& operator+=(const binner& rhs) {
-    if (nbins_total() != rhs.nbins_total()) throw std::length_error(
-      "binner::operator+=: nbins_total does not match");
+private:
+  template <typename C>
+  using detect_add_bins =
+    decltype(std::declval<C&>().add_bins(std::declval<const C&>()));
+
+  template <typename C = container_type>
+  std::enable_if_t<!is_detected<detect_add_bins,C>::value>
+  add_bins(const C& bins) {
     for (size_type i=nbins_total(); i!=0;) {
       --i;
-      _bins[i] += rhs._bins[i];
+      _bins[i] += bins[i];
     }
+  }
+  template <typename C = container_type>
+  std::enable_if_t<is_detected<detect_add_bins,C>::value>
+  add_bins(const C& bins) { _bins.add_bins(bins); } // e.g. sparse
+
+  template <typename C>
+  using detect_find_bin_ptr =
+    decltype(std::declval<const C&>().find(size_type()));
+
+  // bins[i] += bins[j], without inserting empty bins into containers
+  // that have find(), e.g. sparse
+  template <typename C = container_type>
+  inline std::enable_if_t<!is_detected<detect_find_bin_ptr,C>::value>
+  add_bin(size_type i, size_type j) { _bins[i] += _bins[j]; }
+  template <typename C = container_type>
+  inline std::enable_if_t<is_detected<detect_find_bin_ptr,C>::value>
+  add_bin(size_type i, size_type j) {
+    const auto* b = static_cast<const C&>(_bins).find(j);
+    if (!b) return;
+    const value_type x = *b; // inserting may move b
+    _bins[i] += x;
+  }
+
+  template <typename C>
+  using detect_add_range = decltype(std::declval<C&>().add_range(
+    size_type(), size_type(), size_type()));
+
+  // bins[i+k] += bins[j+k] for k in [0,n), the ranges do not overlap;
+  // containers with add_range, e.g. struct-of-arrays, add field by field
+  template <typename C = container_type>
+  inline std::enable_if_t<!is_detected<detect_add_range,C>::value>
+  add_bin_range(size_type i, size_type j, size_type n) {
+    for (size_type k=0; k<n; ++k) add_bin(i+k,j+k);
+  }
+  template <typename C = container_type>
+  inline std::enable_if_t<is_detected<detect_add_range,C>::value>
+  add_bin_range(size_type i, size_type j, size_type n) {
+    _bins.add_range(i,j,n);
+  }
+
+public:
+  binner& operator+=(const binner& rhs) {
+    if (nbins_total() != rhs.nbins_total()) throw std::length_error(
+      "binner::operator+=: nbins_total does not match");
+    add_bins(rhs._bins);
     return *this;
   }
 
@@ -262,13 +442,13 @@ public:
     return index_impl(ii,std::make_index_sequence<naxes>());
   }
 
-  inline const value_type& bin(subst_t<Ax,size_type>... ii) const {
+  inline const_reference bin(subst_t<Ax,size_type>... ii) const {
     return _bins[index_impl(ii...)];
   }
-  inline const value_type& bin(index_array_cref ii) const {
+  inline const_reference bin(index_array_cref ii) const {
     return _bins[index_impl(ii,std::make_index_sequence<naxes>())];
   }
-  inline const value_type& operator[](index_array_cref ii) const {
+  inline const_reference operator[](index_array_cref ii) const {
     return bin(ii);
   }
 
@@ -284,6 +464,13 @@ public:
     return find_bin_tuple(args,std::make_index_sequence<naxes>());
   }
 
+  // find bins for arrays of n values per axis ----------------------
+  template <typename... T>
+  inline void find_bins(size_type n, size_type* ii, const T*... xs) const {
+    static_assert(sizeof...(T)==naxes,"");
+    find_bins_impl(n,ii,std::make_index_sequence<naxes>(),xs...);
+  }
+
   // fill bin -------------------------------------------------------
   template <typename... Args>
   inline size_type fill_bin(size_type bin, Args&&... args) {
@@ -326,45 +513,77 @@ public:
     return fill(args...);
   }
 
-  // Algorithms -----------------------------------------------------
-  template <unsigned I=0> void integrate_right() {
-    const size_type nb = nbins_before<I>();
-    const size_type n  = nbins<I>()-1;
-    const size_type na = nbins_after<I>();
-
-    auto begin = _bins.begin();
-    for (size_type a=na; a; --a) {
-      for (size_type b=nb; b;) { --b;
-        auto prev = begin;
-        for (size_type i=n; i; --i) {
-          auto it = std::next(prev,nb);
-          *it += *prev;
-          prev = it;
-        }
-        if (b) ++begin;
-        else begin = std::next(prev);
-      }
+  // batch fill -----------------------------------------------------
+  // Same as calling fill(xs[k]...) for k = 0..n-1 in order.
+  // If an excep axis throws, the entries before the throwing one are
+  // filled, as they would be by fill().
+  // The first naxes arrays are the axes coordinates,
+  // the rest are passed on to the filler (e.g. weights).
+  template <typename... T>
+  std::enable_if_t<(sizeof...(T)>=naxes)>
+  fill_batch(size_type n, const T*... xs) {
+    size_type ii[IVANP_BINNER_BATCH_SIZE];
+    for (size_type k=0; k<n; ) {
+      const size_type m = std::min<size_type>(n-k,IVANP_BINNER_BATCH_SIZE);
+      fill_batch_impl( m, ii, std::make_tuple((xs+k)...),
+        std::make_index_sequence<naxes>(),
+        ivanp::seq::make_index_range<naxes,sizeof...(T)>() );
+      k += m;
     }
   }
-  template <unsigned I=0> void integrate_left() {
+  template <typename C, typename... CC>
+  auto fill_batch(const C& c, const CC&... cs)
+  -> std::enable_if_t<(sizeof...(CC)+1>=naxes),
+       void_t<decltype(c.data()),decltype(cs.data())...>>
+  {
+    const size_type n = c.size();
+    const std::array<size_type,sizeof...(CC)> ms { size_type(cs.size())... };
+    for (size_type m : ms)
+      if (m != n) throw std::length_error(
+        "binner::fill_batch: array sizes do not match");
+    fill_batch(n,c.data(),cs.data()...);
+  }
+
+  // Algorithms -----------------------------------------------------
+  // Cumulative sums along axis I. A line is the set of bins that differ
+  // only in the index of axis I, there are nbins_total()/nbins<I>() lines.
+  // Lines [first,last) are processed in tiles of neighbouring lines,
+  // so that the inner loop runs over contiguous bins.
+  // Distinct lines share no bins and may be processed concurrently.
+  template <unsigned I>
+  void integrate_lines(bool right, size_type first, size_type last) {
     const size_type nb = nbins_before<I>();
-    const size_type n  = nbins<I>()-1;
-    const size_type na = nbins_after<I>();
-
-    auto begin = _bins.rbegin();
-    for (size_type a=na; a; --a) {
-      for (size_type b=nb; b;) { --b;
-        auto prev = begin;
-        for (size_type i=n; i; --i) {
-          auto it = std::next(prev,nb);
-          *it += *prev;
-          prev = it;
+    const size_type n  = nbins<I>();
+    const size_type step = nb*n;
+    while (first < last) {
+      const size_type a = first / nb, b0 = first % nb;
+      const size_type b1 = std::min<size_type>({
+        nb, b0 + (last-first), b0 + IVANP_BINNER_INTEGRATE_TILE });
+      const size_type base = a*step;
+      if (right) {
+        for (size_type i=1; i<n; ++i) {
+          const size_type row = base + i*nb;
+          add_bin_range(row+b0,row-nb+b0,b1-b0);
+        }
+      } else {
+        for (size_type i=n-1; i; --i) {
+          const size_type row = base + (i-1)*nb;
+          add_bin_range(row+b0,row+nb+b0,b1-b0);
         }
-        if (b) ++begin;
-        else begin = std::next(prev);
       }
+      first += b1-b0;
     }
   }
+
+  // Integrate along each of the axes I in turn
+  template <unsigned I=0, unsigned... Is> void integrate_right() {
+    integrate_lines<I>(true,0,nbins_total()/nbins<I>());
+    UNFOLD( integrate_lines<Is>(true,0,nbins_total()/nbins<Is>()) )
+  }
+  template <unsigned I=0, unsigned... Is> void integrate_left() {
+    integrate_lines<I>(false,0,nbins_total()/nbins<I>());
+    UNFOLD( integrate_lines<Is>(false,0,nbins_total()/nbins<Is>()) )
+  }
 };
 
 template <typename B, typename... A, typename C, typename F>
@@ -0,0 +1,135 @@
+#ifndef IVANP_BINNER_BOOTSTRAP_BIN_HH
+#define IVANP_BINNER_BOOTSTRAP_BIN_HH
+
+// Poisson bootstrap with R replicas kept in every bin.
+// Replica weights are drawn once per event from a counter-based generator
+// keyed on the event number, so they do not depend on thread scheduling
+// or on the order of events.
+//
+//   bootstrap_weights<64> boot(seed);
+//   binner<bootstrap_bin<64>, axes> hist(...);
+//   for (each event) {
+//     boot.event(event_number);
+//     hist(x, boot, weight);
+//   }
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+namespace ivanp {
+
+namespace detail { namespace bootstrap {
+
+// splitmix64 finalizer
+inline uint64_t mix(uint64_t x) noexcept {
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+
+// Poisson(1) CDF for k = 0..10, scaled to 2^32
+constexpr uint32_t poisson1_cdf[] = {
+  1580030168u, 3160060337u, 3950075421u, 4213413783u, 4279248373u,
+  4292415291u, 4294609777u, 4294923276u, 4294962463u, 4294966817u,
+  4294967252u
+};
+
+}} // end namespace detail::bootstrap
+
+// Poisson(1) weights of the current event, one per replica
+template <size_t R>
+class bootstrap_weights {
+  std::array<unsigned char,R> _w;
+  uint64_t _seed;
+
+public:
+  static constexpr size_t nreplicas = R;
+
+  explicit bootstrap_weights(uint64_t seed = 0) noexcept
+  : _w(), _seed(seed) { _w.fill(1); }
+
+  // Draw weights for an event. The result depends only on seed and event.
+  bootstrap_weights& event(uint64_t event) noexcept {
+    using namespace detail::bootstrap;
+    const uint64_t key = mix(_seed ^ mix(event));
+    for (size_t i=0; i<R; ++i) {
+      const uint32_t u = mix(key + i*0x9E3779B97F4A7C15ull) >> 32;
+      unsigned char k = 0;
+      for (uint32_t c : poisson1_cdf) k += (u >= c);
+      _w[i] = k;
+    }
+    return *this;
+  }
+
+  inline unsigned operator[](size_t i) const noexcept { return _w[i]; }
+  inline const unsigned char* data() const noexcept { return _w.data(); }
+  inline uint64_t seed() const noexcept { return _seed; }
+};
+
+// Weighted bin with R bootstrap replicas of the sum of weights
+template <size_t R, typename T = double, typename Count = unsigned long>
+struct bootstrap_bin {
+  T w = 0, w2 = 0;
+  Count n = 0;
+  std::array<T,R> rw { };
+
+  bootstrap_bin& operator()(const bootstrap_weights<R>& b, T weight) noexcept {
+    w += weight;
+    w2 += weight*weight;
+    ++n;
+    const unsigned char* __restrict p = b.data();
+    T* __restrict r = rw.data();
+    for (size_t i=0; i<R; ++i) r[i] += T(p[i])*weight;
+    return *this;
+  }
+  bootstrap_bin& operator()(const bootstrap_weights<R>& b) noexcept {
+    return (*this)(b,T(1));
+  }
+
+  bootstrap_bin& operator+=(const bootstrap_bin& o) noexcept {
+    w += o.w;
+    w2 += o.w2;
+    n += o.n;
+    for (size_t i=0; i<R; ++i) rw[i] += o.rw[i];
+    return *this;
+  }
+
+  static constexpr size_t nreplicas() noexcept { return R; }
+
+  // variance of the sum of weights over the replicas
+  T replica_var() const noexcept {
+    T mean = 0;
+    for (size_t i=0; i<R; ++i) mean += rw[i];
+    mean /= R;
+    T var = 0;
+    for (size_t i=0; i<R; ++i) var += (rw[i]-mean)*(rw[i]-mean);
+    return R > 1 ? var/(R-1) : T(0);
+  }
+  inline T replica_stdev() const noexcept { return std::sqrt(replica_var()); }
+};
+
+// Bin converter that selects one replica,
+// e.g. for to_root(hist, name, bootstrap_replica{k})
+struct bootstrap_replica {
+  size_t k;
+
+  template <typename Bin>
+  inline auto val (const Bin& b) const noexcept { return b.rw[k]; }
+  template <typename Bin>
+  inline auto num (const Bin& b) const noexcept { return b.n; }
+};
+
+// Bin converter with the bootstrap variance as the error
+struct bootstrap_error {
+  template <typename Bin>
+  inline auto val (const Bin& b) const noexcept { return b.w; }
+  template <typename Bin>
+  inline auto err2(const Bin& b) const noexcept { return b.replica_var(); }
+  template <typename Bin>
+  inline auto num (const Bin& b) const noexcept { return b.n; }
+};
+
+} // end namespace ivanp
+
+#endif
@@ -0,0 +1,135 @@
+#ifndef IVANP_BINNER_BUFFERED_HH
+#define IVANP_BINNER_BUFFERED_HH
+
+#include <vector>
+#include <array>
+#include <tuple>
+#include <algorithm>
+
+#include "ivanp/binner/binner.hh"
+
+#ifndef IVANP_FILL_BUFFER_SIZE
+#define IVANP_FILL_BUFFER_SIZE (1u<<16)
+#endif
+
+namespace ivanp {
+
+// Fill buffer in front of a binner with many more bins than fit in cache.
+// Fills are recorded as (bin index, fill arguments), radix-sorted by
+// index when the buffer is full and applied in memory order.
+// The sort is stable, so every bin sees its fills in the original order.
+// Args are the types of the fill arguments after the axes values,
+// e.g. double for a weight.
+//
+// NOTE: the binner is held by reference and is behind the buffer
+// until flush() is called. Read it through the buffer, whose accessors
+// flush first, or call flush() before using the binner directly.
+// Pending fills are also applied when the buffer is destroyed.
+template <typename Binner, typename... Args>
+class buffered_binner {
+public:
+  using binner_type = Binner;
+  using size_type = typename binner_type::size_type;
+  using record_type = std::pair<size_type,std::tuple<Args...>>;
+  static constexpr unsigned naxes = binner_type::naxes;
+
+private:
+  binner_type& _hist;
+  std::vector<record_type> _recs, _tmp;
+  size_type _capacity;
+  unsigned _key_bits;
+
+  template <typename T, size_t... I>
+  inline size_type find(const T& t, std::index_sequence<I...>) const {
+    return _hist.find_bin(std::get<I>(t)...);
+  }
+  template <typename T, size_t... I>
+  inline void push(size_type bin, const T& t, std::index_sequence<I...>) {
+    _recs.emplace_back(std::piecewise_construct,
+      std::forward_as_tuple(bin), std::forward_as_tuple(std::get<I>(t)...));
+  }
+  template <size_t... I>
+  inline void apply(record_type& r, std::index_sequence<I...>) {
+    _hist.fill_bin(r.first, std::get<I>(r.second)...);
+  }
+
+  // LSD radix sort on bytes of the bin index
+  void sort() {
+    const size_type n = _recs.size();
+    _tmp.resize(n);
+    for (unsigned shift=0; shift<_key_bits; shift+=8) {
+      std::array<size_type,257> count { };
+      for (const auto& r : _recs) ++count[((r.first >> shift) & 0xFF) + 1];
+      if (std::find(count.begin(),count.end(),n) != count.end())
+        continue; // all records in one bucket
+      for (unsigned i=1; i<257; ++i) count[i] += count[i-1];
+      for (auto& r : _recs)
+        _tmp[count[(r.first >> shift) & 0xFF]++] = std::move(r);
+      _recs.swap(_tmp);
+    }
+  }
+
+public:
+  buffered_binner(binner_type& hist,
+    size_type capacity = IVANP_FILL_BUFFER_SIZE
+  ): _hist(hist), _capacity(capacity ? capacity : 1), _key_bits(0) {
+    _recs.reserve(_capacity);
+    const size_type m = hist.nbins_total()-1;
+    while (_key_bits < 8*sizeof(size_type) && (m >> _key_bits))
+      _key_bits += 8;
+  }
+  buffered_binner(const buffered_binner&) = delete;
+  buffered_binner& operator=(const buffered_binner&) = delete;
+  // the moved-from buffer is left empty, so it does not flush again
+  buffered_binner(buffered_binner&& o)
+  : _hist(o._hist), _recs(std::move(o._recs)), _tmp(std::move(o._tmp)),
+    _capacity(o._capacity), _key_bits(o._key_bits)
+  { o._recs.clear(); }
+  ~buffered_binner() { flush(); }
+
+  template <typename... T>
+  size_type fill(const T&... args) {
+    static_assert(sizeof...(T)==naxes+sizeof...(Args),
+      "fill arguments do not match axes and Args");
+    const auto tup = std::forward_as_tuple(args...);
+    const size_type bin = find(tup,std::make_index_sequence<naxes>());
+    if (bin == size_type(-1)) return bin;
+    push(bin,tup,seq::make_index_range<naxes,sizeof...(T)>());
+    if (_recs.size() >= _capacity) flush();
+    return bin;
+  }
+  template <typename... T>
+  inline size_type operator()(const T&... args) { return fill(args...); }
+
+  void flush() {
+    if (_recs.empty()) return;
+    sort();
+    for (auto& r : _recs) apply(r,std::index_sequence_for<Args...>());
+    _recs.clear();
+  }
+
+  size_type size() const noexcept { return _recs.size(); }
+  size_type capacity() const noexcept { return _capacity; }
+
+  // read access, flushes first -------------------------------------
+  const binner_type& get() { flush(); return _hist; }
+  const binner_type& operator*() { return get(); }
+  const binner_type* operator->() { return &get(); }
+
+  decltype(auto) bins() { return get().bins(); }
+  decltype(auto) bin(typename binner_type::index_array_cref ii)
+  { return get().bin(ii); }
+  decltype(auto) operator[](typename binner_type::index_array_cref ii)
+  { return get()[ii]; }
+  auto begin() { return get().begin(); }
+  auto   end() { return get().end(); }
+};
+
+template <typename... Args, typename Binner>
+inline buffered_binner<Binner,Args...> make_buffered(Binner& hist,
+  typename Binner::size_type capacity = IVANP_FILL_BUFFER_SIZE
+) { return { hist, capacity }; }
+
+} // end namespace ivanp
+
+#endif
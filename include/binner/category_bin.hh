@@ -7,32 +7,146 @@
 
 namespace ivanp {
 
-template <typename Bin, typename E, typename... Es>
-struct category_bin {
+namespace detail { namespace category {
+
+template <typename E, typename... Es> struct index_of;
+template <typename E>
+struct index_of<E>: std::integral_constant<size_t,0> { };
+template <typename E, typename... Es>
+struct index_of<E,E,Es...>: std::integral_constant<size_t,0> { };
+template <typename E, typename E1, typename... Es>
+struct index_of<E,E1,Es...>
+: std::integral_constant<size_t,1+index_of<E,Es...>::value> { };
+
+template <typename E>
+inline unsigned check_id(unsigned i) {
+  if (!(i < enum_traits<E>::size())) throw error(
+    "\"",enum_traits<E>::name(),"\" category (size=",
+    enum_traits<E>::size(),") index out of range (i=",i,")");
+  return i;
+}
+
+}} // end namespace detail::category
+
+// Selected categories for a chain of nested category_bins.
+// Pass it as the first fill argument instead of using the
+// thread-local selection in category_bin.
+template <typename... Es>
+class category_context {
+public:
+  using id_type = unsigned;
+
+private:
+  std::array<id_type,sizeof...(Es)> _ids { };
+
+  template <typename E>
+  using index = detail::category::index_of<E,Es...>;
+
+public:
+  template <typename E>
+  std::enable_if_t<(index<E>::value < sizeof...(Es)),id_type>
+  id() const noexcept { return std::get<index<E>::value>(_ids); }
+  template <typename E>
+  constexpr std::enable_if_t<!(index<E>::value < sizeof...(Es)),id_type>
+  id() const noexcept { return 0; }
+
+  template <typename E>
+  std::enable_if_t<(index<E>::value < sizeof...(Es)),id_type>
+  id(id_type i) {
+    return std::get<index<E>::value>(_ids) =
+      detail::category::check_id<E>(i);
+  }
+  template <typename E>
+  constexpr std::enable_if_t<!(index<E>::value < sizeof...(Es)),id_type>
+  id(id_type) const noexcept { return 0; }
+};
+
+template <typename> struct is_category_context: std::false_type { };
+template <typename... Es>
+struct is_category_context<category_context<Es...>>: std::true_type { };
+
+namespace detail { namespace category {
+template <typename... T>
+struct first_is_context: std::false_type { };
+template <typename T, typename... TT>
+struct first_is_context<T,TT...>: is_category_context<std::decay_t<T>> { };
+}}
+
+// Deferred: only the selected category bin is filled at each level,
+// bins[0] holds fills with no category selected and total() adds the
+// categories to it when read. The stored bins never include the sum,
+// so they can be added, merged and exported any number of times.
+template <bool Deferred, typename Bin, typename E, typename... Es>
+struct basic_category_bin {
   using id_type = unsigned;
-  static id_type _id;
   using category = E;
+  using context = category_context<E,Es...>;
+  using deferred = std::integral_constant<bool,Deferred>;
 
   template <typename...>
   struct next_bin { using type = Bin; };
   template <typename _E, typename... _Es>
-  struct next_bin<_E,_Es...> { using type = category_bin<Bin,_E,_Es...>; };
+  struct next_bin<_E,_Es...> {
+    using type = basic_category_bin<Deferred,Bin,_E,_Es...>;
+  };
 
   using bin_type = typename next_bin<Es...>::type;
 
   std::array< bin_type, enum_traits<E>::size() > bins;
 
+  using is_base = std::integral_constant<bool,!sizeof...(Es)>;
+
+  // Selection used when filling without a context.
+  // There is one for each thread and each level type, so it is shared
+  // by all bins with the same nested levels, e.g. id<E2>() of
+  // category_bin<Bin,E1,E2> also selects for category_bin<Bin,E2>.
+  // Pass a context to fill to keep selections of binners apart.
+  static thread_local id_type _id;
+
+private:
+  template <typename C, typename... T, typename B = is_base>
+  static std::enable_if_t<!B::value>
+  fill_bin(bin_type& bin, const C& ctx, T&&... args) noexcept {
+    bin(ctx,std::forward<T>(args)...);
+  }
+  template <typename C, typename... T, typename B = is_base>
+  static std::enable_if_t< B::value>
+  fill_bin(bin_type& bin, const C&, T&&... args) noexcept {
+    bin(std::forward<T>(args)...);
+  }
+
+public:
   template <typename... T>
-  category_bin& operator()(T&&... args) noexcept {
-    std::get<0>(bins)(std::forward<T>(args)...);
-    if (_id) bins AT(_id)(std::forward<T>(args)...);
+  std::enable_if_t<
+    !detail::category::first_is_context<T...>::value, basic_category_bin&>
+  operator()(T&&... args) noexcept {
+    if (!Deferred) std::get<0>(bins)(std::forward<T>(args)...);
+    if (Deferred || _id) bins AT(_id)(std::forward<T>(args)...);
     return *this;
   }
-  category_bin& operator+=(const category_bin& b) noexcept {
+  template <typename... Cs, typename... T>
+  basic_category_bin& operator()(
+    const category_context<Cs...>& ctx, T&&... args
+  ) noexcept {
+    if (!Deferred) fill_bin(std::get<0>(bins),ctx,std::forward<T>(args)...);
+    const id_type i = ctx.template id<E>();
+    if (Deferred || i) fill_bin(bins AT(i),ctx,std::forward<T>(args)...);
+    return *this;
+  }
+  basic_category_bin& operator+=(const basic_category_bin& b) noexcept {
     for (auto i=bins.size(); i; ) --i, bins AT(i) += b.bins AT(i);
     return *this;
   }
 
+  // The inclusive bin of this level, bins[0] unless Deferred.
+  // Nested levels of the result are not summed, read their total() too.
+  bin_type total() const {
+    bin_type t = std::get<0>(bins);
+    if (Deferred)
+      for (size_t i=1; i<bins.size(); ++i) t += bins AT(i);
+    return t;
+  }
+
   template <typename _E>
   static std::enable_if_t<std::is_same<_E,E>::value,id_type>& id() {
     return _id;
@@ -46,10 +160,7 @@ struct category_bin {
 
   template <typename _E>
   static std::enable_if_t<std::is_same<_E,E>::value,id_type> id(id_type i) {
-    if (!(i < enum_traits<E>::size())) throw error(
-      "\"",enum_traits<E>::name(),"\" category (size=",
-      enum_traits<E>::size(),") index out of range (i=",i,")");
-    return _id = i;
+    return _id = detail::category::check_id<E>(i);
   }
   template <typename _E>
   static std::enable_if_t<
@@ -62,8 +173,29 @@ struct category_bin {
     !std::is_same<_E,E>::value && !sizeof...(Es), id_type
   > id(id_type) noexcept { return 0; }
 
-  using is_base = std::integral_constant<bool,!sizeof...(Es)>;
+  // Bin of the categories selected in ctx
+  template <typename... Cs, typename T = is_base>
+  std::enable_if_t<!T::value,const Bin&>
+  get(const category_context<Cs...>& ctx) const {
+    return bins AT(ctx.template id<E>()).get(ctx);
+  }
+  template <typename... Cs, typename T = is_base>
+  std::enable_if_t<!T::value,Bin&>
+  get(const category_context<Cs...>& ctx) {
+    return bins AT(ctx.template id<E>()).get(ctx);
+  }
+  template <typename... Cs, typename T = is_base>
+  std::enable_if_t< T::value,const Bin&>
+  get(const category_context<Cs...>& ctx) const {
+    return bins AT(ctx.template id<E>());
+  }
+  template <typename... Cs, typename T = is_base>
+  std::enable_if_t< T::value,Bin&>
+  get(const category_context<Cs...>& ctx) {
+    return bins AT(ctx.template id<E>());
+  }
 
+  // Bin of the categories selected without a context
   template <typename T = is_base>
   std::enable_if_t<!T::value,const Bin&> operator*() const {
     return *bins AT(_id);
@@ -85,8 +217,15 @@ struct category_bin {
   const Bin* operator->() const { return &**this; }
 };
 
+template <bool Deferred, typename Bin, typename E, typename... Es>
+thread_local typename basic_category_bin<Deferred,Bin,E,Es...>::id_type
+basic_category_bin<Deferred,Bin,E,Es...>::_id = 0;
+
+template <typename Bin, typename E, typename... Es>
+using category_bin = basic_category_bin<false,Bin,E,Es...>;
+
 template <typename Bin, typename E, typename... Es>
-typename category_bin<Bin,E,Es...>::id_type category_bin<Bin,E,Es...>::_id = 0;
+using deferred_category_bin = basic_category_bin<true,Bin,E,Es...>;
 
 }
 
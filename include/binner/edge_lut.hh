@@ -0,0 +1,99 @@
+#ifndef IVANP_EDGE_LUT_HH
+#define IVANP_EDGE_LUT_HH
+
+// Search accelerator for axes with many variable width bins.
+// A coarse uniform lookup table maps x to the short range of edges that
+// can contain the answer, which is then searched without branches.
+// find() returns the same index as std::upper_bound,
+// i.e. the ROOT-style bin number.
+
+#include <vector>
+#include <cmath>
+#include <type_traits>
+
+#include "ivanp/binner/fwd/axis.hh"
+
+namespace ivanp {
+
+template <typename EdgeType>
+class edge_lut {
+public:
+  using edge_type = EdgeType;
+  using size_type = axis_size_type;
+  static constexpr size_type linear_max = 16;
+
+private:
+  // _lut[j] is the number of edges in buckets before j
+  std::vector<size_type> _lut;
+  edge_type _min, _max;
+  double _scale;
+
+  // monotonic in x, which makes the lookup table exact
+  template <typename T>
+  inline size_type bucket(const T& x) const noexcept {
+    const size_type nb = _lut.size()-1;
+    const size_type j = (double(x)-double(_min))*_scale;
+    return j < nb ? j : nb-1;
+  }
+
+public:
+  edge_lut() = default;
+  edge_lut(const edge_type* edges, size_type n, size_type nbuckets = 0)
+  : _lut((nbuckets ? nbuckets : n)+1),
+    _min(n ? edges[0] : edge_type()), _max(n ? edges[n-1] : edge_type()),
+    _scale((_lut.size()-1)/(double(_max)-double(_min)))
+  {
+    if (!(_min < _max) || !std::isfinite(_scale)) {
+      // fewer than 2 distinct edges or a range too narrow to scale,
+      // one bucket with all the edges
+      _lut = { 0, n };
+      _scale = 0;
+      return;
+    }
+    const size_type nb = _lut.size()-1;
+    size_type i = 0;
+    for (size_type j=0; j<=nb; ++j) {
+      while (i<n && bucket(edges[i]) < j) ++i;
+      _lut[j] = i;
+    }
+  }
+  template <typename C>
+  edge_lut(const C& edges, size_type nbuckets = 0)
+  : edge_lut(edges.data(), edges.size(), nbuckets) { }
+
+  template <typename T>
+  size_type find(const edge_type* edges, const T& x) const noexcept {
+    if (x < _min) return 0;
+    if (!(x < _max)) return _lut.back();
+    const size_type j = bucket(x);
+    size_type first = _lut[j];
+    size_type n = _lut[j+1] - first;
+    const edge_type* base = edges + first;
+    if (n <= linear_max) {
+      for (size_type i=0; i<n; ++i) first += !(x < base[i]);
+      return first;
+    }
+    while (n > 1) {
+      const size_type half = n/2;
+      base = (x < base[half]) ? base : base+half;
+      n -= half;
+    }
+    return (base - edges) + !(x < *base);
+  }
+
+  size_type nbuckets() const noexcept { return _lut.size()-1; }
+};
+
+// used by axes that do not opt into the lookup table
+struct no_edge_lut {
+  no_edge_lut() = default;
+  template <typename... T>
+  constexpr no_edge_lut(const T&...) noexcept { }
+};
+
+template <typename EdgeType, bool Use>
+using edge_lut_t = std::conditional_t<Use, edge_lut<EdgeType>, no_edge_lut>;
+
+} // end namespace ivanp
+
+#endif
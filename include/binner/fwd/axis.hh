@@ -0,0 +1,13 @@
+#ifndef IVANP_AXIS_FWD_HH
+#define IVANP_AXIS_FWD_HH
+
+namespace ivanp {
+
+using axis_size_type = unsigned;
+
+// defined in variant_axis.hh
+template <typename EdgeType, bool Inherit=false> class variant_axis;
+
+} // end namespace ivanp
+
+#endif
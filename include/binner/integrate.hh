@@ -0,0 +1,55 @@
+#ifndef IVANP_BINNER_INTEGRATE_HH
+#define IVANP_BINNER_INTEGRATE_HH
+
+// Parallel cumulative sums of binners.
+// Lines along the axis are split into tiles that are processed by
+// nthreads threads. The container must allow concurrent writes to
+// distinct bins, which is not the case for sparse_bins.
+//
+//   integrate_right<0,1>(hist); // 2D cumulative distribution
+
+#include <thread>
+
+#include "ivanp/binner/binner.hh"
+#include "ivanp/binner/sharded.hh"
+
+namespace ivanp {
+
+namespace detail { namespace integrate {
+
+template <unsigned I, typename Binner>
+void lines(Binner& hist, bool right, unsigned nthreads) {
+  using size_type = typename Binner::size_type;
+  const size_type nlines = hist.nbins_total()/hist.template nbins<I>();
+  const size_type tile = IVANP_BINNER_INTEGRATE_TILE;
+  const size_type ntiles = (nlines + tile-1)/tile;
+  detail::sharded::parallel_for(ntiles, nthreads, [&](size_type k){
+    hist.template integrate_lines<I>(right,
+      k*tile, std::min<size_type>(nlines,(k+1)*tile));
+  });
+}
+
+inline unsigned default_nthreads() noexcept {
+  const unsigned n = std::thread::hardware_concurrency();
+  return n ? n : 1;
+}
+
+}} // end namespace detail::integrate
+
+// Integrate along each of the axes I in turn
+template <unsigned... I, typename Binner>
+void integrate_right(Binner& hist,
+  unsigned nthreads = detail::integrate::default_nthreads()
+) {
+  UNFOLD( detail::integrate::lines<I>(hist,true,nthreads) )
+}
+template <unsigned... I, typename Binner>
+void integrate_left(Binner& hist,
+  unsigned nthreads = detail::integrate::default_nthreads()
+) {
+  UNFOLD( detail::integrate::lines<I>(hist,false,nthreads) )
+}
+
+} // end namespace ivanp
+
+#endif
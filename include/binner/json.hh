@@ -2,15 +2,21 @@
 #define IVANP_BINNER_JSON_HH
 
 #include <ostream>
+#include <sstream>
+#include <string>
+#include <limits>
 #include "ivanp/binner/binner.hh"
+#include "ivanp/io/json_writer.hh"
 #include "ivanp/unfold.hh"
+#include "ivanp/detect.hh"
+#include "ivanp/boolean.hh"
 
 namespace ivanp {
 
 namespace detail {
 
-template <typename AxisSpec>
-void axis_to_json(std::ostream& os, const typename AxisSpec::axis& axis) {
+template <typename AxisSpec, typename Out>
+void axis_to_json(Out& os, const typename AxisSpec::axis& axis) {
   os << "{\"uf\":" << AxisSpec::under::value
      << ",\"of\":" << AxisSpec::over::value
      << ",\"edges\":[";
@@ -23,21 +29,25 @@ void axis_to_json(std::ostream& os, const typename AxisSpec::axis& axis) {
 }
 
 template <
+  typename Out,
   typename Bin,
   typename AxesSpecs,
   typename Container,
   typename Filler,
+  typename F,
   size_t... I>
 void to_json(
-  std::ostream& os,
+  Out& os,
   const binner<Bin,AxesSpecs,Container,Filler>& hist,
+  F write_bin,
   std::index_sequence<I...>
 ) {
-  os << std::boolalpha << "{\"axes\":[";
+  os << "{\"axes\":[";
 
   UNFOLD((
     os << (I ? "," : ""),
-    axis_to_json<std::tuple_element_t<I,AxesSpecs>>(os,hist.template axis<I>())
+    axis_to_json<std::tuple_element_t<I,AxesSpecs>>(os,
+      hist.template axis<I>())
   ))
 
   os << "],\"bins\":[";
@@ -45,10 +55,71 @@ void to_json(
   for (const auto& bin : hist.bins()) {
     if (first) first = false;
     else os << ',';
-    to_json(os,bin);
+    write_bin(os,bin);
   }
   os << "]}";
 }
+
+// bins with members w, w2 and n, e.g. nlo_bin, are written as [w,w2,n]
+template <typename B>
+using detect_weight_members = decltype(
+  std::declval<const B&>().w, std::declval<const B&>().w2,
+  std::declval<const B&>().n);
+template <typename B>
+using has_weight_members = bool_constant<
+  is_detected<detect_weight_members,B>::value &&
+  !std::is_arithmetic<B>::value>;
+
+template <typename Out, typename B>
+inline void write_weight_members(Out& os, const B& b) {
+  os << '[' << b.w << ',' << b.w2 << ',' << b.n << ']';
+}
+
+// bins with a to_json for ostreams, then bins with w, w2 and n
+template <typename B>
+inline auto write_bin(std::ostream& os, const B& b, int)
+-> decltype(to_json(os,b),void()) { to_json(os,b); }
+template <typename B>
+inline std::enable_if_t<has_weight_members<B>::value>
+write_bin(std::ostream& os, const B& b, long) { write_weight_members(os,b); }
+
+// bins with a to_json for json_writer, arithmetic bins,
+// bins with w, w2 and n, and bins with a to_json for ostreams,
+// in that order
+template <typename B>
+inline auto write_bin(json_writer& w, const B& b, int)
+-> decltype(to_json(w,b),void()) { to_json(w,b); }
+template <typename B>
+inline std::enable_if_t<std::is_arithmetic<B>::value>
+write_bin(json_writer& w, const B& b, long) { w << b; }
+template <typename B>
+inline std::enable_if_t<has_weight_members<B>::value>
+write_bin(json_writer& w, const B& b, long) { write_weight_members(w,b); }
+template <typename B>
+inline std::enable_if_t<
+  !std::is_arithmetic<B>::value && !has_weight_members<B>::value>
+write_bin(json_writer& w, const B& b, long) {
+  // last resort, with bools as words and numbers that read back exactly
+  thread_local std::stringstream ss;
+  ss.str(std::string());
+  ss.clear();
+  ss << std::boolalpha;
+  ss.precision(std::numeric_limits<double>::max_digits10);
+  write_bin(static_cast<std::ostream&>(ss),b,0);
+  const std::string str = ss.str();
+  w.write(str.data(),str.size());
+}
+
+template <typename F>
+struct write_converted {
+  const F& convert;
+  template <typename Out, typename B>
+  void operator()(Out& os, const B& bin) const {
+    os << '[' << convert.val(bin) << ',' << convert.err2(bin)
+       << ',' << convert.num(bin) << ']';
+  }
+};
+
 }
 
 template <
@@ -60,7 +131,61 @@ void to_json(
   std::ostream& os,
   const binner<Bin,AxesSpecs,Container,Filler>& hist
 ) {
+  os << std::boolalpha;
   detail::to_json(os,hist,
+    [](std::ostream& os, const auto& bin){ detail::write_bin(os,bin,0); },
+    std::make_index_sequence<std::tuple_size<AxesSpecs>::value>{});
+}
+
+// Bins are written as [val,err2,num] using a bin converter,
+// e.g. multiweight_variation to select one variation.
+template <
+  typename Bin,
+  typename AxesSpecs,
+  typename Container,
+  typename Filler,
+  typename F>
+void to_json(
+  std::ostream& os,
+  const binner<Bin,AxesSpecs,Container,Filler>& hist,
+  F convert
+) {
+  os << std::boolalpha;
+  detail::to_json(os,hist,detail::write_converted<F>{convert},
+    std::make_index_sequence<std::tuple_size<AxesSpecs>::value>{});
+}
+
+// Buffered output, same layout.
+// Numbers are written in the shortest round-trip form.
+//
+//   json_writer out(fd); // or json_writer out(ostream);
+//   to_json(out,hist);
+template <
+  typename Bin,
+  typename AxesSpecs,
+  typename Container,
+  typename Filler>
+void to_json(
+  json_writer& os,
+  const binner<Bin,AxesSpecs,Container,Filler>& hist
+) {
+  detail::to_json(os,hist,
+    [](json_writer& os, const auto& bin){ detail::write_bin(os,bin,0); },
+    std::make_index_sequence<std::tuple_size<AxesSpecs>::value>{});
+}
+
+template <
+  typename Bin,
+  typename AxesSpecs,
+  typename Container,
+  typename Filler,
+  typename F>
+void to_json(
+  json_writer& os,
+  const binner<Bin,AxesSpecs,Container,Filler>& hist,
+  F convert
+) {
+  detail::to_json(os,hist,detail::write_converted<F>{convert},
     std::make_index_sequence<std::tuple_size<AxesSpecs>::value>{});
 }
 
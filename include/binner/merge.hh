@@ -0,0 +1,172 @@
+#ifndef IVANP_BINNER_MERGE_HH
+#define IVANP_BINNER_MERGE_HH
+
+// N-way merge of binner snapshots.
+// Inputs are mmapped and their bins are summed chunk by chunk. Each
+// chunk is a pairwise tree sum over the inputs, so the result does not
+// depend on the number of threads. The output is produced one window at
+// a time, which bounds the memory use independently of the input size.
+// Checksums of the inputs are computed window by window as they are
+// read for summing, so each input is read from storage once.
+//
+//   merge_snapshots<weight_bin<>>("sum.bin", {"job1.bin","job2.bin"});
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <thread>
+#include <cstdio>
+#include <algorithm>
+
+#include "ivanp/binner/snapshot.hh"
+#include "ivanp/binner/sharded.hh"
+
+#ifndef IVANP_MERGE_CHUNK
+#define IVANP_MERGE_CHUNK (1u<<12) // bins
+#endif
+
+#ifndef IVANP_MERGE_WINDOW
+#define IVANP_MERGE_WINDOW (1u<<24) // bytes
+#endif
+
+namespace ivanp {
+
+namespace detail { namespace merge {
+
+template <typename Bin>
+inline void add(Bin* __restrict a, const Bin* __restrict b, size_t n) {
+  for (size_t i=0; i<n; ++i) a[i] += b[i];
+}
+template <typename Bin>
+inline void add(Bin* __restrict out,
+  const Bin* __restrict a, const Bin* __restrict b, size_t n
+) {
+  for (size_t i=0; i<n; ++i) {
+    out[i] = a[i];
+    out[i] += b[i];
+  }
+}
+
+// out = sum of in[l..r)[first,first+n), buf has room for the tree levels
+template <typename Bin>
+void tree_sum(Bin* out, const std::vector<const Bin*>& in,
+  size_t l, size_t r, size_t first, size_t n, Bin* buf
+) {
+  const size_t m = r-l;
+  if (m == 1) std::copy(in[l]+first, in[l]+first+n, out);
+  else if (m == 2) add(out, in[l]+first, in[l+1]+first, n);
+  else {
+    const size_t mid = l + m/2;
+    tree_sum(out, in, l, mid, first, n, buf+n);
+    tree_sum(buf, in, mid, r, first, n, buf+n);
+    add(out, buf, n);
+  }
+}
+
+inline unsigned tree_depth(size_t n) noexcept {
+  unsigned d = 0;
+  for (; n > 2; n = n - n/2) ++d;
+  return d;
+}
+
+inline unsigned default_nthreads() noexcept {
+  const unsigned n = std::thread::hardware_concurrency();
+  return n ? n : 1;
+}
+
+}} // end namespace detail::merge
+
+// Sum snapshots of identically binned binners with bins of type Bin
+// and write the result as a snapshot to out.
+// Checksums of the inputs are verified if verify. If they do not match,
+// an exception is thrown and no output is written.
+template <typename Bin>
+void merge_snapshots(
+  const std::string& out, const std::vector<std::string>& in,
+  unsigned nthreads = detail::merge::default_nthreads(), bool verify = true
+) {
+  using namespace detail::snapshot;
+  using detail::sharded::parallel_for;
+  static_assert(std::is_trivially_copyable<Bin>::value,
+    "snapshot bins must be trivially copyable");
+  if (in.empty()) throw error("merge_snapshots: no inputs");
+
+  // open and validate -----------------------------------------------
+  // checksums are verified later, while summing
+  std::vector<std::unique_ptr<snapshot_file>> files(in.size());
+  for (size_t k=0; k<in.size(); ++k)
+    files[k].reset(new snapshot_file(in[k],false));
+  const snapshot_file& first = *files.front();
+  if ( first.bin_size() != sizeof(Bin)
+    || first.bin_type() != type_tag<Bin>() ) throw error(
+    "snapshot \"",in.front(),"\": bin type does not match");
+  for (size_t k=1; k<files.size(); ++k)
+    if (!first.compatible(*files[k])) throw error(
+      "snapshot \"",in[k],"\": binning differs from \"",in.front(),'\"');
+
+  std::vector<const Bin*> bins(files.size());
+  for (size_t k=0; k<files.size(); ++k)
+    bins[k] = reinterpret_cast<const Bin*>(files[k]->payload());
+
+  // output ----------------------------------------------------------
+  header h = first.header();
+  const size_t axes_size = h.payload - sizeof(h);
+  std::vector<checksum> in_sums(verify ? files.size() : 0);
+  for (size_t k=0; k<in_sums.size(); ++k)
+    in_sums[k].update(files[k]->axes(),axes_size);
+
+  const std::string tmp = out + '.' + std::to_string(::getpid());
+  std::ofstream f(tmp, std::ios::binary);
+  if (!f) throw error("cannot write snapshot \"",tmp,"\"");
+  try {
+    checksum sum;
+    sum.update(first.axes(),axes_size);
+    f.write(reinterpret_cast<const char*>(&h),sizeof(h));
+    f.write(first.axes(),axes_size);
+
+    // sum one window at a time --------------------------------------
+    const size_t nbins = h.nbins;
+    const size_t chunk = IVANP_MERGE_CHUNK;
+    const size_t window = std::max<size_t>(
+      IVANP_MERGE_WINDOW/sizeof(Bin)/chunk, 1) * chunk;
+    const unsigned depth = detail::merge::tree_depth(files.size());
+    std::vector<Bin> buf(std::min(window,nbins));
+
+    for (size_t w0=0; w0<nbins; w0+=window) {
+      const size_t wn = std::min(window,nbins-w0);
+      const size_t nchunks = (wn + chunk-1)/chunk;
+      // pages of the window are read in here and summed from memory
+      if (verify) parallel_for(files.size(), nthreads, [&](unsigned k){
+        in_sums[k].update(bins[k]+w0,wn*sizeof(Bin));
+      });
+      parallel_for(nchunks, nthreads, [&](unsigned c){
+        const size_t c0 = c*chunk, cn = std::min(chunk,wn-c0);
+        std::vector<Bin> levels(depth*cn);
+        detail::merge::tree_sum(buf.data()+c0, bins, 0, bins.size(),
+          w0+c0, cn, levels.data());
+      });
+      sum.update(buf.data(),wn*sizeof(Bin));
+      f.write(reinterpret_cast<const char*>(buf.data()),wn*sizeof(Bin));
+    }
+
+    for (size_t k=0; k<in_sums.size(); ++k)
+      if (in_sums[k].digest() != files[k]->header().checksum) throw error(
+        "snapshot \"",in[k],"\": checksum mismatch");
+
+    h.checksum = sum.digest();
+    f.seekp(0);
+    f.write(reinterpret_cast<const char*>(&h),sizeof(h));
+    f.close();
+    if (!f || std::rename(tmp.c_str(), out.c_str()))
+      throw error("cannot write snapshot \"",out,"\"");
+  } catch (...) {
+    f.close();
+    std::remove(tmp.c_str());
+    throw;
+  }
+}
+
+} // end namespace ivanp
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef IVANP_BINNER_MULTIWEIGHT_BIN_HH
+#define IVANP_BINNER_MULTIWEIGHT_BIN_HH
+
+// Bin with many weights per fill, e.g. one per systematic variation.
+// The bin is found once and all variations are updated in one loop.
+// N is the number of variations, or 0 for a number set at runtime.
+// With N = 0, a bin takes its number of variations from the first fill
+// or addition, so each binner uses the number of weights it is filled
+// with. Bins that were never filled read as zero for every variation.
+//
+//   binner<multiweight_bin<double>, axes> hist(...);
+//   hist(x, weights); // weights is a std::vector<double>
+//   to_root(hist, "name_var3", multiweight_variation{3});
+
+#include <vector>
+#include <array>
+#include <stdexcept>
+#include <type_traits>
+
+namespace ivanp {
+
+namespace detail { namespace multiweight {
+
+template <typename T>
+inline void add(T* __restrict w, T* __restrict w2,
+  const T* __restrict x, size_t n
+) noexcept {
+  for (size_t i=0; i<n; ++i) {
+    w [i] += x[i];
+    w2[i] += x[i]*x[i];
+  }
+}
+template <typename T>
+inline void add(T* __restrict a, const T* __restrict b, size_t n) noexcept {
+  for (size_t i=0; i<n; ++i) a[i] += b[i];
+}
+
+template <typename T, size_t N>
+struct storage {
+  using type = std::array<T,N>;
+  static type make(size_t) { return { }; }
+  static bool fit(type&, size_t n) noexcept { return n == N; }
+};
+template <typename T>
+struct storage<T,0> {
+  using type = std::vector<T>;
+  static type make(size_t n) { return type(n); }
+  // sizes an empty bin on first use
+  static bool fit(type& w, size_t n) {
+    if (w.empty()) w.resize(n);
+    return n == w.size();
+  }
+};
+
+}} // end namespace detail::multiweight
+
+template <typename T = double, size_t N = 0, typename Count = unsigned long>
+struct multiweight_bin {
+  using value_type = T;
+  using container_type = typename detail::multiweight::storage<T,N>::type;
+
+private:
+  using storage = detail::multiweight::storage<T,N>;
+
+public:
+  container_type w = storage::make(0), w2 = storage::make(0);
+  Count n = 0;
+
+  multiweight_bin() = default;
+  // with nw variations, if N is 0
+  explicit multiweight_bin(size_t nw)
+  : w(storage::make(nw)), w2(storage::make(nw)) { }
+
+  // nw weights, one per variation
+  multiweight_bin& operator()(const T* ws, size_t nw) {
+    if (!(storage::fit(w,nw) && storage::fit(w2,nw)))
+      throw std::length_error(
+        "multiweight_bin: number of weights does not match");
+    detail::multiweight::add(w.data(),w2.data(),ws,nw);
+    ++n;
+    return *this;
+  }
+  template <typename C>
+  inline auto operator()(const C& ws)
+  -> decltype(ws.data(),ws.size(),std::declval<multiweight_bin&>()) {
+    return (*this)(ws.data(),ws.size());
+  }
+
+  multiweight_bin& operator+=(const multiweight_bin& o) {
+    if (o.w.empty()) { n += o.n; return *this; }
+    if (!(storage::fit(w,o.w.size()) && storage::fit(w2,o.w2.size())))
+      throw std::length_error(
+        "multiweight_bin: number of variations does not match");
+    detail::multiweight::add(w.data(),o.w.data(),w.size());
+    detail::multiweight::add(w2.data(),o.w2.data(),w2.size());
+    n += o.n;
+    return *this;
+  }
+
+  inline size_t nvariations() const noexcept { return w.size(); }
+
+  inline T weight(size_t k) const noexcept
+  { return k < w.size() ? w[k] : T(); }
+  inline T sumw2 (size_t k) const noexcept
+  { return k < w2.size() ? w2[k] : T(); }
+};
+
+// Bin converter that selects one variation,
+// e.g. for to_root(hist, name, multiweight_variation{k})
+struct multiweight_variation {
+  size_t k;
+
+  template <typename Bin>
+  inline auto val (const Bin& b) const noexcept { return b.weight(k); }
+  template <typename Bin>
+  inline auto err2(const Bin& b) const noexcept { return b.sumw2(k); }
+  template <typename Bin>
+  inline auto num (const Bin& b) const noexcept { return b.n; }
+};
+
+} // end namespace ivanp
+
+#endif
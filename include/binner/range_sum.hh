@@ -0,0 +1,275 @@
+#ifndef IVANP_BINNER_RANGE_SUM_HH
+#define IVANP_BINNER_RANGE_SUM_HH
+
+// Range integrals of binners in 2^D prefix lookups.
+// summed_area is a static table of prefix sums built from a binner.
+// fenwick_sum is a Fenwick tree that is updated by filling through it,
+// so it stays valid as the binner is filled.
+//
+// Ranges are half-open in bin indices, which include underflow and
+// overflow bins if the axes have them. Edge ranges [a,b) are rounded to
+// the bins that contain a and b, they are exact if a and b are edges.
+//
+//   summed_area<decltype(hist)> sa(hist);
+//   sa.integral<1>({0.,2.5}); // 0 <= x1 < 2.5, all bins in other axes
+
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+
+#include "ivanp/binner/binner.hh"
+
+namespace ivanp {
+
+namespace detail { namespace range_sum {
+
+// sum of weights for weighted bins, the bin itself for arithmetic bins
+struct bin_value {
+  template <typename B>
+  inline auto val(const B& b) const noexcept -> decltype(b.w) { return b.w; }
+  template <typename B>
+  inline std::enable_if_t<std::is_arithmetic<B>::value,B>
+  val(const B& b) const noexcept { return b; }
+};
+
+template <typename Derived, typename Binner, typename F>
+class base {
+public:
+  using binner_type = Binner;
+  using size_type = typename binner_type::size_type;
+  static constexpr unsigned naxes = binner_type::naxes;
+  using index_array_type = std::array<size_type,naxes>;
+  using range_type = std::array<size_type,2>;
+  using value_type = std::decay_t<decltype( std::declval<const F&>().val(
+    std::declval<typename binner_type::const_reference>()) )>;
+
+protected:
+  const binner_type& _hist;
+  F _get;
+  index_array_type _n; // nbins of each axis, including under & overflow
+
+  template <size_t... I>
+  static index_array_type nbins(const binner_type& h, std::index_sequence<I...>)
+  { return {{ h.template nbins<I>()... }}; }
+
+  base(const binner_type& hist, F get)
+  : _hist(hist), _get(get),
+    _n(nbins(hist,std::make_index_sequence<naxes>())) { }
+
+  // strides of tables with indices [0,n[d]] in each axis,
+  // the first axis is the fastest, as in the binner
+  static index_array_type make_strides(const index_array_type& n) noexcept {
+    index_array_type s;
+    size_type k = 1;
+    for (unsigned d=0; d<naxes; ++d) { s[d] = k; k *= n[d]+1; }
+    return s;
+  }
+
+  const Derived& derived() const noexcept
+  { return static_cast<const Derived&>(*this); }
+
+public:
+  const binner_type& hist() const noexcept { return _hist; }
+
+  // Sum over bins with lo[d] <= i[d] < hi[d] in every axis d
+  value_type sum(const std::array<range_type,naxes>& r) const {
+    for (unsigned d=0; d<naxes; ++d)
+      if (r[d][0] >= r[d][1]) return 0;
+    value_type s = 0;
+    index_array_type h;
+    for (size_type c=0; c<(size_type(1)<<naxes); ++c) {
+      bool neg = false;
+      for (unsigned d=0; d<naxes; ++d) {
+        const bool lo = (c >> d) & 1;
+        h[d] = std::min(r[d][!lo],_n[d]);
+        neg ^= lo;
+      }
+      const value_type p = derived().prefix(h);
+      if (neg) s -= p; else s += p;
+    }
+    return s;
+  }
+
+  // Sum over edge ranges [a,b) of axes I, all bins of other axes
+  template <unsigned... I>
+  value_type integral(
+    const std::array<typename binner_type::template edge_type<I>,2>&... x
+  ) const {
+    std::array<range_type,naxes> r;
+    for (unsigned d=0; d<naxes; ++d) r[d] = {{ 0, _n[d] }};
+    UNFOLD(( r[I] = {{ index<I>(x[0]), index<I>(x[1]) }} ))
+    return sum(r);
+  }
+
+  // Index of the bin containing x, clamped to [0,nbins<I>()]
+  template <unsigned I>
+  size_type index(typename binner_type::template edge_type<I> x) const {
+    using spec = typename binner_type::template axis_spec<I>;
+    const size_type i = _hist.template axis<I>().find_bin(x);
+    if (!spec::under::value && i==0) return 0;
+    return std::min<size_type>(i - !spec::under::value, _n[I]);
+  }
+};
+
+}} // end namespace detail::range_sum
+
+// Static table of prefix sums.
+// Rebuild it with update() after the binner is filled.
+template <typename Binner, typename F = detail::range_sum::bin_value>
+class summed_area
+: public detail::range_sum::base<summed_area<Binner,F>,Binner,F> {
+  using base = detail::range_sum::base<summed_area,Binner,F>;
+  friend base;
+public:
+  using typename base::size_type;
+  using typename base::value_type;
+  using typename base::index_array_type;
+  using base::naxes;
+
+private:
+  index_array_type _s;
+  std::vector<value_type> _p; // prefix sums, 0 at index 0 of any axis
+
+  value_type prefix(const index_array_type& h) const noexcept {
+    size_type i = 0;
+    for (unsigned d=0; d<naxes; ++d) i += h[d]*_s[d];
+    return _p[i];
+  }
+
+public:
+  summed_area(const Binner& hist, F get = { })
+  : base(hist,get), _s(base::make_strides(this->_n)) { update(); }
+
+  // Recompute the table from the binner
+  void update() {
+    const auto& n = this->_n;
+    _p.assign(_s[naxes-1]*(n[naxes-1]+1),value_type(0));
+
+    // copy bins shifted by 1 in every axis
+    index_array_type ii { };
+    for (const auto& bin : this->_hist.bins()) {
+      size_type i = 0;
+      for (unsigned d=0; d<naxes; ++d) i += (ii[d]+1)*_s[d];
+      _p[i] = this->_get.val(bin);
+      for (unsigned d=0; d<naxes && ++ii[d]==n[d]; ++d) ii[d] = 0;
+    }
+
+    // cumulative sums along each axis, contiguous inner loop
+    const size_type size = _p.size();
+    for (unsigned d=0; d<naxes; ++d) {
+      const size_type s = _s[d], step = s*(n[d]+1);
+      for (size_type a=0; a<size; a+=step)
+        for (size_type i=a+s; i<a+step; i+=s)
+          for (size_type b=0; b<s; ++b)
+            _p[i+b] += _p[i-s+b];
+    }
+  }
+};
+
+// Fenwick tree of bin values.
+// Fill the binner through it to keep the tree up to date.
+template <typename Binner, typename F = detail::range_sum::bin_value>
+class fenwick_sum
+: public detail::range_sum::base<fenwick_sum<Binner,F>,Binner,F> {
+  using base = detail::range_sum::base<fenwick_sum,Binner,F>;
+  friend base;
+public:
+  using typename base::size_type;
+  using typename base::value_type;
+  using typename base::index_array_type;
+  using base::naxes;
+
+private:
+  Binner& _mhist;
+  index_array_type _s;
+  std::vector<value_type> _t; // 1-based in every axis
+
+  static inline size_type lowbit(size_type i) noexcept { return i & (~i+1); }
+
+  value_type prefix(const index_array_type& h,
+    unsigned d = naxes-1, size_type off = 0
+  ) const noexcept {
+    value_type s = 0;
+    for (size_type i=h[d]; i; i-=lowbit(i)) {
+      if (d) s += prefix(h,d-1,off+i*_s[d]);
+      else s += _t[off+i];
+    }
+    return s;
+  }
+
+  void add(const index_array_type& j, value_type x,
+    unsigned d = naxes-1, size_type off = 0
+  ) noexcept {
+    const size_type n = this->_n[d];
+    for (size_type i=j[d]+1; i<=n; i+=lowbit(i)) {
+      if (d) add(j,x,d-1,off+i*_s[d]);
+      else _t[off+i] += x;
+    }
+  }
+
+  template <typename T, size_t... I>
+  inline size_type find(const T& t, std::index_sequence<I...>) const {
+    return _mhist.find_bin(std::get<I>(t)...);
+  }
+  template <typename T, size_t... I>
+  inline void fill_bin(size_type bin, const T& t, std::index_sequence<I...>)
+  { _mhist.fill_bin(bin,std::get<I>(t)...); }
+
+public:
+  fenwick_sum(Binner& hist, F get = { })
+  : base(hist,get), _mhist(hist), _s(base::make_strides(this->_n))
+  { update(); }
+
+  // Rebuild the tree from the binner in linear time
+  void update() {
+    const auto& n = this->_n;
+    _t.assign(_s[naxes-1]*(n[naxes-1]+1),value_type(0));
+    index_array_type ii { };
+    for (const auto& bin : this->_hist.bins()) {
+      size_type i = 0;
+      for (unsigned d=0; d<naxes; ++d) i += (ii[d]+1)*_s[d];
+      _t[i] = this->_get.val(bin);
+      for (unsigned d=0; d<naxes && ++ii[d]==n[d]; ++d) ii[d] = 0;
+    }
+    const size_type size = _t.size();
+    for (unsigned d=0; d<naxes; ++d) {
+      const size_type s = _s[d], step = s*(n[d]+1);
+      for (size_type a=0; a<size; a+=step)
+        for (size_type i=1; i<=n[d]; ++i) {
+          const size_type p = i + lowbit(i);
+          if (p > n[d]) continue;
+          for (size_type b=0; b<s; ++b)
+            _t[a+p*s+b] += _t[a+i*s+b];
+        }
+    }
+  }
+
+  // Fill the binner and add the change of the bin value to the tree
+  template <typename... T>
+  size_type fill(const T&... args) {
+    static_assert(sizeof...(T)>=naxes,
+      "fill arguments do not match axes");
+    const auto tup = std::forward_as_tuple(args...);
+    const size_type bin = find(tup,std::make_index_sequence<naxes>());
+    if (bin == size_type(-1)) return bin;
+    const auto& bins = this->_hist.bins(); // const, no insertion
+    const value_type before = this->_get.val(bins[bin]);
+    fill_bin(bin,tup,seq::make_index_range<naxes,sizeof...(T)>());
+    const value_type x = this->_get.val(bins[bin]) - before;
+    index_array_type j;
+    size_type k = bin;
+    for (unsigned d=0; d<naxes; ++d) {
+      j[d] = k % this->_n[d];
+      k /= this->_n[d];
+    }
+    add(j,x);
+    return bin;
+  }
+  template <typename... T>
+  inline size_type operator()(const T&... args) { return fill(args...); }
+};
+
+} // end namespace ivanp
+
+#endif
@@ -16,7 +16,9 @@ private:
   store *_store;
 
 public:
-  re_axes(const std::string& filename);
+  // If use_cache, the parsed config is cached in filename+".cache",
+  // which is reused while the config text is unchanged
+  re_axes(const std::string& filename, bool use_cache = false);
   ~re_axes();
   axis_type operator[](const std::string& name) const;
 };
@@ -0,0 +1,147 @@
+#ifndef IVANP_BINNER_SHARDED_HH
+#define IVANP_BINNER_SHARDED_HH
+
+#include <vector>
+#include <thread>
+#include <exception>
+#include <algorithm>
+
+#include "ivanp/binner/binner.hh"
+
+namespace ivanp {
+
+namespace detail { namespace sharded {
+
+// calls f(k) for k in [0,n) on up to nthreads threads
+// an exception thrown by f stops its thread and is rethrown after join
+template <typename F>
+void parallel_for(unsigned n, unsigned nthreads, F&& f) {
+  if (nthreads > n) nthreads = n;
+  if (nthreads < 2) {
+    for (unsigned k=0; k<n; ++k) f(k);
+    return;
+  }
+  std::vector<std::exception_ptr> errors(nthreads);
+  std::vector<std::thread> threads;
+  threads.reserve(nthreads);
+  for (unsigned t=0; t<nthreads; ++t)
+    threads.emplace_back([&f,&errors,n,nthreads,t]{
+      try {
+        for (unsigned k=t; k<n; k+=nthreads) f(k);
+      } catch (...) {
+        errors[t] = std::current_exception();
+      }
+    });
+  for (auto& thread : threads) thread.join();
+  for (const auto& e : errors)
+    if (e) std::rethrow_exception(e);
+}
+
+template <typename C>
+using detect_add_bins =
+  decltype(std::declval<C&>().add_bins(std::declval<const C&>()));
+
+// bins += o, split between threads
+template <typename C>
+std::enable_if_t<!is_detected<detect_add_bins,C>::value>
+add_bins(C& bins, const C& o, size_t nbins, unsigned nthreads) {
+  if (nthreads < 1) nthreads = 1;
+  const size_t chunk = (nbins+nthreads-1)/nthreads;
+  parallel_for(nthreads, nthreads, [&](unsigned t){
+    const size_t a = t*chunk, b = std::min(a+chunk,nbins);
+    for (size_t i=a; i<b; ++i) bins[i] += o[i];
+  });
+}
+// containers with their own add_bins and clear(), e.g. sparse, which
+// cannot be inserted into concurrently, or struct-of-arrays
+template <typename C>
+std::enable_if_t<is_detected<detect_add_bins,C>::value>
+add_bins(C& bins, const C& o, size_t, unsigned) { bins.add_bins(o); }
+
+template <typename C>
+std::enable_if_t<!is_detected<detect_add_bins,C>::value>
+clear_bins(C& bins) {
+  for (auto&& bin : bins) bin = typename C::value_type{};
+}
+template <typename C>
+std::enable_if_t<is_detected<detect_add_bins,C>::value>
+clear_bins(C& bins) { bins.clear(); }
+
+}} // end namespace detail::sharded
+
+template <typename Binner> class sharded_binner;
+
+// Per-thread replicas of a binner.
+// Each worker fills its own shard, the shards refer to the axes of the
+// target binner. reduce() adds the shards into the target.
+template <typename Bin, typename... Ax, typename Container, typename Filler>
+class sharded_binner<binner<Bin,std::tuple<Ax...>,Container,Filler>> {
+public:
+  using binner_type = binner<Bin,std::tuple<Ax...>,Container,Filler>;
+  using shard_type = binner<Bin,
+    std::tuple< axis_spec< const typename Ax::axis&,
+      Ax::under::value, Ax::over::value, Ax::excep::value >... >,
+    Container, Filler>;
+  using size_type = typename binner_type::size_type;
+
+private:
+  binner_type& _hist;
+  std::vector<shard_type> _shards;
+
+  template <size_t... I>
+  void make_shards(unsigned n, std::index_sequence<I...>) {
+    _shards.reserve(n);
+    for (unsigned i=0; i<n; ++i)
+      _shards.emplace_back(std::get<I>(_hist.axes())...);
+  }
+
+public:
+  sharded_binner(binner_type& hist,
+    unsigned nshards = std::thread::hardware_concurrency()
+  ): _hist(hist) {
+    make_shards(std::max(nshards,1u),std::index_sequence_for<Ax...>{});
+  }
+
+  unsigned nshards() const noexcept { return _shards.size(); }
+
+  shard_type& operator[](unsigned i) noexcept { return _shards[i]; }
+  const shard_type& operator[](unsigned i) const noexcept
+  { return _shards[i]; }
+
+  template <typename... Args>
+  inline size_type fill(unsigned shard, const Args&... args) {
+    return _shards[shard].fill(args...);
+  }
+
+  binner_type& target() noexcept { return _hist; }
+
+  // Adds all shards into the target binner and zeroes them.
+  // Shards are merged pairwise in a fixed tree order,
+  // so the result does not depend on thread scheduling.
+  void reduce(unsigned nthreads = std::thread::hardware_concurrency()) {
+    using namespace detail::sharded;
+    const unsigned n = _shards.size();
+    for (unsigned s=1; s<n; s*=2) {
+      const unsigned npairs = (n-s+2*s-1)/(2*s);
+      parallel_for(npairs, nthreads, [this,s](unsigned k){
+        _shards[2*s*k] += _shards[2*s*k+s];
+      });
+    }
+
+    add_bins(_hist.bins(), _shards.front().bins(),
+      _hist.nbins_total(), nthreads);
+
+    parallel_for(n, nthreads, [this](unsigned i){
+      clear_bins(_shards[i].bins());
+    });
+  }
+};
+
+template <typename Binner>
+inline sharded_binner<Binner> make_sharded(Binner& hist,
+  unsigned nshards = std::thread::hardware_concurrency()
+) { return { hist, nshards }; }
+
+} // end namespace ivanp
+
+#endif
@@ -2,90 +2,95 @@
 #define IVANP_BINNER_SLICE_HH
 
 #include "ivanp/binner/binner.hh"
-#include <memory>
-#include <functional>
+#include <iterator>
 
 namespace ivanp {
 
-namespace detail { namespace slice {
-
-template <size_t N>
-class counter {
+// Read-only view of a D-dimensional slice of a bin container.
+// Holds only a pointer to the container, the offset of the first bin,
+// and the strides and numbers of bins of the D axes.
+template <typename Container, size_t D>
+class strided_bins {
+public:
   using size_type = ivanp::axis_size_type;
+  using index_array_type = std::array<size_type,D>;
+  using value_type = typename Container::value_type;
+  using const_reference =
+    decltype(std::declval<const Container&>()[size_type(0)]);
+  using reference = const_reference;
 
-  std::array<size_type,N> _ii, _nn;
-  bool _next, _done;
+private:
+  const Container* _c;
+  size_type _base;
+  index_array_type _s, _n;
 
 public:
-  template <typename M, size_t... I>
-  counter(const M& m, std::index_sequence<I...>) noexcept
-  : _ii{zero(I)...}, _nn{std::get<I>(m)...},
-    _next(false), _done(!sizeof...(I)) { }
-
-  counter& operator++() noexcept {
-    _next = false;
-    ++_ii[0];
-    for (size_type i=0; i<N; ++i) {
-      if (_ii[i] == _nn[i]) {
-        _ii[i] = 0;
-        _next = true;
-        if (i==N-1) _done = true;
-        else ++_ii[i+1];
+  class const_iterator {
+    const strided_bins* _v;
+    size_type _i, _off;
+    index_array_type _ii;
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = strided_bins::value_type;
+    using difference_type = std::ptrdiff_t;
+    using reference = strided_bins::const_reference;
+    using pointer = void;
+
+    const_iterator(const strided_bins* v, size_type i) noexcept
+    : _v(v), _i(i), _off(v->_base), _ii{} { }
+
+    reference operator*() const { return (*_v->_c)[_off]; }
+
+    const_iterator& operator++() noexcept {
+      ++_i;
+      _off += _v->_s[0];
+      for (size_t d=0; d<D-1 && ++_ii[d]==_v->_n[d]; ++d) {
+        _ii[d] = 0;
+        _off += _v->_s[d+1] - _v->_n[d]*_v->_s[d];
       }
+      return *this;
+    }
+    const_iterator operator++(int) noexcept {
+      auto tmp = *this;
+      ++*this;
+      return tmp;
     }
-    return *this;
-  }
 
-  inline operator bool() const noexcept { return _done; }
-  inline bool next() const noexcept { return _next; }
-  inline const std::array<size_type,N>& ii() const noexcept { return _ii; }
-  size_type size() const noexcept {
-    size_type s = 1;
-    for (const auto& n : _nn) s *= n;
-    return s;
-  }
-  inline void reset() noexcept { _done = false; }
-};
+    bool operator==(const const_iterator& o) const noexcept
+    { return _i == o._i; }
+    bool operator!=(const const_iterator& o) const noexcept
+    { return _i != o._i; }
+  };
+  using iterator = const_iterator;
 
-template <size_t I=0, size_t N>
-inline std::enable_if_t<I==N-1, ivanp::axis_size_type> index(
-  const std::array<const ivanp::axis_size_type*,N>& ii,
-  const std::array<ivanp::axis_size_type,N>& nn
-) noexcept {
-  return *std::get<I>(ii);
-}
-template <size_t I=0, size_t N>
-inline std::enable_if_t<I!=N-1, ivanp::axis_size_type> index(
-  const std::array<const ivanp::axis_size_type*,N>& ii,
-  const std::array<ivanp::axis_size_type,N>& nn
-) noexcept {
-  return *std::get<I>(ii) + std::get<I>(nn) * index<I+1>(ii,nn);
-}
+  strided_bins(const Container& c, size_type base,
+    const index_array_type& strides, const index_array_type& nbins
+  ) noexcept: _c(&c), _base(base), _s(strides), _n(nbins) { }
 
-template <typename T, size_t N1, size_t N2, size_t... I1, size_t... I2>
-inline auto cat_cptr(
-  const std::array<T,N1>& arr1,
-  const std::array<T,N2>& arr2,
-  std::index_sequence<I1...>,
-  std::index_sequence<I2...>
-) -> std::array<const T*, N1+N2> {
-  static_assert(sizeof...(I1) == N1,"");
-  static_assert(sizeof...(I2) == N2,"");
-  return { &std::get<I1>(arr1)..., &std::get<I2>(arr2)... };
-}
+  size_type size() const noexcept {
+    size_type n = 1;
+    for (size_type x : _n) n *= x;
+    return n;
+  }
 
-template <typename T, size_t N, size_t... I>
-inline std::array<T,N> sort(std::array<T,N> arr, std::index_sequence<I...>) {
-  static_assert(sizeof...(I) == N,"");
-  return { std::get<I>(arr)... };
-}
+  const_reference operator[](size_type i) const {
+    size_type off = _base;
+    for (size_t d=0; d<D; ++d) {
+      off += (i % _n[d]) * _s[d];
+      i /= _n[d];
+    }
+    return (*_c)[off];
+  }
 
-} // end namespace slice
-} // end namespace detail
+  const_iterator begin() const noexcept { return { this, 0 }; }
+  const_iterator   end() const noexcept { return { this, size() }; }
+};
 
-template <size_t D, typename Bin, typename Ax> struct binner_slice;
-template <size_t D, typename Bin, typename... Ax>
-class binner_slice<D, Bin, std::tuple<Ax...>> {
+template <size_t D, typename Bin, typename Ax,
+          typename Container = std::vector<Bin>>
+struct binner_slice;
+template <size_t D, typename Bin, typename... Ax, typename Container>
+class binner_slice<D, Bin, std::tuple<Ax...>, Container> {
   // types ----------------------------------------------------------
   using head = std::make_index_sequence<D>;
   using tail = seq::make_index_range<D,sizeof...(Ax)>;
@@ -117,10 +122,10 @@ class binner_slice<D, Bin, std::tuple<Ax...>> {
   };
 
 public:
-  // binner with reference to axes and bins
+  // binner with reference to axes and a view of the bins
   using binner_type = binner< Bin,
     typename cref_axis_specs<specs_head>::type,
-    std::vector<std::reference_wrapper<const Bin>> >;
+    strided_bins<Container,D> >;
 
 private:
   // members --------------------------------------------------------
@@ -201,68 +206,123 @@ public:
   // ----------------------------------------------------------------
 };
 
-template <size_t D=1, // slicing into chunks of D dimensions
-          typename Bin,
-          typename... Ax,
-          typename Container,
-          typename Filler,
-          size_t... I
->
-auto slice(
-  const binner<Bin,std::tuple<Ax...>,Container,Filler>& hist,
-  std::index_sequence<I...>
-) {
+// Range of the slices of a binner, produced one at a time by iteration.
+// Axes are reordered by I, the first D of them are kept in the slices.
+template <size_t D, typename Binner, typename I> class binner_slices;
+template <size_t D,
+          typename Bin, typename... Ax, typename Container, typename Filler,
+          size_t... I>
+class binner_slices<D, binner<Bin,std::tuple<Ax...>,Container,Filler>,
+                    std::index_sequence<I...>> {
   static_assert( sizeof...(I) == sizeof...(Ax),
     "\033[33mthe number of indices must match the number of axes\033[0m");
   static_assert( D > 0,
     "\033[33mmust leave at least 1 dimension unsliced\033[0m");
   static_assert( D < sizeof...(I),
     "\033[33mnumber of unsliced dimensions must be less than total\033[0m");
-  using namespace ivanp::detail::slice;
 
+  using hist_type = binner<Bin,std::tuple<Ax...>,Container,Filler>;
   using specs = std::tuple<Ax...>;
-  using head = std::make_index_sequence<D>;
-  using tail = seq::make_index_range<D,sizeof...(I)>;
-  using inv  = seq::inverse_t<std::index_sequence<I...>>;
+  using size_type = ivanp::axis_size_type;
+  static constexpr size_t N = sizeof...(I), T = N-D;
 
-  using reordered_specs = std::tuple<
-    typename std::tuple_element_t<I,specs>...>;
+public:
+  using slice_type = binner_slice<D, Bin,
+    std::tuple<typename std::tuple_element_t<I,specs>...>, Container>;
+  using reordered_axes_crefs = std::tuple<
+    const typename std::tuple_element_t<I,specs>::axis&...>;
 
-  const auto& axes = hist.axes();
-  const auto reordered_axes = std::tie(ivanp::as_const(std::get<I>(axes))...);
+private:
+  const hist_type* _hist;
+  std::array<size_type,N> _n, _s; // reordered nbins and strides
 
-  const auto reordered_nbins = make_array<ivanp::axis_size_type>(
-    ( std::get<I>(axes).nbins()
-      + std::tuple_element_t<I,specs>::nover::value )... );
-  const auto nbins = sort(reordered_nbins, inv{});
+  size_type tail_size() const noexcept {
+    size_type n = 1;
+    for (size_t t=D; t<N; ++t) n *= _n[t];
+    return n;
+  }
 
-  counter<tail::size()> tcnt(reordered_nbins, tail{});
-  counter<head::size()> hcnt(reordered_nbins, head{});
-  const auto n_head_bins = hcnt.size();
+  slice_type make(const std::array<size_type,T>& ii) const {
+    size_type base = 0;
+    for (size_t t=0; t<T; ++t) base += ii[t]*_s[D+t];
+    std::array<size_type,D> hs, hn;
+    std::copy(_s.begin(),_s.begin()+D,hs.begin());
+    std::copy(_n.begin(),_n.begin()+D,hn.begin());
+    const auto& axes = _hist->axes();
+    return {
+      reordered_axes_crefs(std::get<I>(axes)...), ii,
+      { _hist->bins(), base, hs, hn } };
+  }
 
-  const auto ii = sort(
-    cat_cptr(hcnt.ii(), tcnt.ii(),
-      head{}, std::make_index_sequence<tail::size()>{}),
-    inv{});
+public:
+  class const_iterator {
+    const binner_slices* _r;
+    size_type _k;
+    std::array<size_type,T> _ii;
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = slice_type;
+    using difference_type = std::ptrdiff_t;
+    using reference = slice_type;
+    using pointer = void;
+
+    const_iterator(const binner_slices* r, size_type k) noexcept
+    : _r(r), _k(k), _ii{} { }
+
+    slice_type operator*() const { return _r->make(_ii); }
+
+    const_iterator& operator++() noexcept {
+      ++_k;
+      for (size_t t=0; t<T && ++_ii[t]==_r->_n[D+t]; ++t) _ii[t] = 0;
+      return *this;
+    }
+    const_iterator operator++(int) noexcept {
+      auto tmp = *this;
+      ++*this;
+      return tmp;
+    }
 
-  using slice_t = binner_slice<D, Bin, reordered_specs>;
-  std::vector<slice_t> slices;
-  slices.reserve(tcnt.size());
+    bool operator==(const const_iterator& o) const noexcept
+    { return _k == o._k; }
+    bool operator!=(const const_iterator& o) const noexcept
+    { return _k != o._k; }
+  };
+  using iterator = const_iterator;
 
-  const auto& hbins = hist.bins();
+  binner_slices(const hist_type& hist) noexcept
+  : _hist(&hist),
+    _n{{ hist.template nbins<I>()... }},
+    _s{{ hist.template nbins_before<I>()... }} { }
 
-  for ( ; !tcnt; ++tcnt ) {
-    typename slice_t::binner_type::container_type bins;
-    bins.reserve(n_head_bins);
-    for ( ; !hcnt; ++hcnt ) {
-      bins.emplace_back(std::ref(hbins[index(ii,nbins)]));
-    }
-    hcnt.reset();
+  size_type size() const noexcept { return tail_size(); }
 
-    slices.emplace_back( reordered_axes, tcnt.ii(), std::move(bins) );
+  // k-th slice, the first of the sliced axes is the fastest
+  slice_type operator[](size_type k) const {
+    std::array<size_type,T> ii;
+    for (size_t t=0; t<T; ++t) {
+      ii[t] = k % _n[D+t];
+      k /= _n[D+t];
+    }
+    return make(ii);
   }
 
-  return slices;
+  const_iterator begin() const noexcept { return { this, 0 }; }
+  const_iterator   end() const noexcept { return { this, size() }; }
+};
+
+template <size_t D=1, // slicing into chunks of D dimensions
+          typename Bin,
+          typename... Ax,
+          typename Container,
+          typename Filler,
+          size_t... I
+>
+inline auto slice(
+  const binner<Bin,std::tuple<Ax...>,Container,Filler>& hist,
+  std::index_sequence<I...>
+) {
+  return binner_slices<D, binner<Bin,std::tuple<Ax...>,Container,Filler>,
+                       std::index_sequence<I...>>(hist);
 }
 
 template <size_t D=1, // slicing into chunks of D dimensions
@@ -0,0 +1,389 @@
+#ifndef IVANP_BINNER_SNAPSHOT_HH
+#define IVANP_BINNER_SNAPSHOT_HH
+
+// Native binary snapshots of binners.
+// A snapshot is a header, the axes, and the bins as raw memory, aligned
+// to IVANP_SNAPSHOT_ALIGN bytes. It is read back through mem_file::mmap
+// as a read-only binner that uses the bins in place. Everything after
+// the header is covered by a checksum, which is verified on loading.
+// The header records a tag of the bin type, and the axes record the type
+// of their edges, so a snapshot is only read back with the same types.
+// The format is native endian and not meant to be portable.
+//
+//   write_snapshot("hist.bin", hist);
+//   snapshot<decltype(hist)> snap("hist.bin");
+//   snap->bin({i,j}); // *snap is a binner
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <type_traits>
+#include <typeinfo>
+#include <unistd.h>
+
+#include "ivanp/binner/binner.hh"
+#include "ivanp/binner/variant_axis.hh"
+#include "ivanp/io/mem_file.hh"
+#include "ivanp/error.hh"
+
+#ifndef IVANP_SNAPSHOT_ALIGN
+#define IVANP_SNAPSHOT_ALIGN 64
+#endif
+
+namespace ivanp {
+
+namespace detail { namespace snapshot {
+
+struct header {
+  char magic[8];
+  uint32_t version, naxes;
+  uint64_t bin_size, bin_type, nbins, axes_size, payload, checksum;
+};
+// followed by min and max if uniform, or by nbins+1 edges otherwise,
+// stored as the edge type
+struct axis_record {
+  uint8_t uniform, under, over, excep;
+  uint8_t edge_kind, edge_size;
+  uint16_t reserved;
+  uint64_t nbins;
+};
+
+constexpr char magic[8] = { 'i','v','b','i','n','n','e','r' };
+constexpr uint32_t version = 2;
+
+// FNV-1a hash of the name of the type, same for the same compiler
+template <typename T>
+inline uint64_t type_tag() noexcept {
+  uint64_t h = 0xCBF29CE484222325ull;
+  for (const char* c = typeid(T).name(); *c; ++c)
+    h = (h ^ uint64_t((unsigned char)*c)) * 0x100000001B3ull;
+  return h;
+}
+
+template <typename T>
+constexpr uint8_t edge_kind() noexcept {
+  return std::is_floating_point<T>::value ? 'f'
+       : std::is_integral<T>::value ? (std::is_signed<T>::value ? 'i' : 'u')
+       : 'o';
+}
+
+// Streaming 64-bit checksum, 4 independent lanes of 8 bytes
+class checksum {
+  static constexpr uint64_t p1 = 0x9E3779B185EBCA87ull,
+                            p2 = 0xC2B2AE3D27D4EB4Full;
+  uint64_t _h[4] = { p1+p2, p2, 0, 0-p1 };
+  unsigned char _buf[32];
+  size_t _n = 0;
+  uint64_t _len = 0;
+
+  static inline uint64_t rotl(uint64_t x, int r) noexcept
+  { return (x << r) | (x >> (64-r)); }
+
+  inline void block(const unsigned char* p) noexcept {
+    for (unsigned i=0; i<4; ++i) {
+      uint64_t w;
+      std::memcpy(&w,p+8*i,8);
+      _h[i] = rotl(_h[i] + w*p2, 31) * p1;
+    }
+  }
+
+public:
+  void update(const void* data, size_t n) noexcept {
+    auto p = static_cast<const unsigned char*>(data);
+    _len += n;
+    if (_n) {
+      const size_t m = std::min(n,32-_n);
+      std::memcpy(_buf+_n,p,m);
+      _n += m; p += m; n -= m;
+      if (_n < 32) return;
+      block(_buf);
+      _n = 0;
+    }
+    for (; n>=32; p+=32, n-=32) block(p);
+    std::memcpy(_buf,p,n);
+    _n = n;
+  }
+
+  uint64_t digest() const noexcept {
+    checksum c = *this;
+    if (c._n) {
+      std::memset(c._buf+c._n,0,32-c._n);
+      c.block(c._buf);
+    }
+    uint64_t h = rotl(c._h[0],1) + rotl(c._h[1],7)
+               + rotl(c._h[2],12) + rotl(c._h[3],18) + _len;
+    h = (h ^ (h >> 33)) * p2;
+    h = (h ^ (h >> 29)) * p1;
+    return h ^ (h >> 32);
+  }
+};
+
+inline uint64_t align(uint64_t n) noexcept {
+  return (n + IVANP_SNAPSHOT_ALIGN-1) / IVANP_SNAPSHOT_ALIGN
+    * IVANP_SNAPSHOT_ALIGN;
+}
+
+template <typename T>
+inline void append(std::vector<char>& v, const T* x, size_t n) {
+  const char* p = reinterpret_cast<const char*>(x);
+  v.insert(v.end(), p, p+n*sizeof(T));
+}
+
+template <typename Spec>
+void write_axis(std::vector<char>& v, const typename Spec::axis& a) {
+  using edge_type = typename std::decay_t<typename Spec::axis>::edge_type;
+  static_assert(std::is_trivially_copyable<edge_type>::value,
+    "snapshot edges must be trivially copyable");
+  axis_record r { };
+  r.uniform = a.is_uniform();
+  r.under = Spec::under::value;
+  r.over  = Spec::over::value;
+  r.excep = Spec::excep::value;
+  r.edge_kind = edge_kind<edge_type>();
+  r.edge_size = sizeof(edge_type);
+  r.nbins = a.nbins();
+  append(v,&r,1);
+  if (r.uniform) {
+    const edge_type e[2] = { a.min(), a.max() };
+    append(v,e,2);
+  } else
+    for (axis_size_type i=0, n=a.nedges(); i<n; ++i) {
+      const edge_type e = a.edge(i);
+      append(v,&e,1);
+    }
+}
+
+template <typename Specs, typename Axes, size_t... I>
+inline void write_axes(std::vector<char>& v, const Axes& axes,
+  std::index_sequence<I...>
+) {
+  UNFOLD(( write_axis<std::tuple_element_t<I,Specs>>(v,std::get<I>(axes)) ))
+}
+
+// read-only view of the bins in the snapshot
+template <typename Bin>
+class bins_view {
+  const Bin* _p = nullptr;
+  axis_size_type _n = 0;
+public:
+  using value_type = Bin;
+  using const_reference = const Bin&;
+  using reference = const Bin&;
+  using size_type = axis_size_type;
+  using const_iterator = const Bin*;
+  using iterator = const Bin*;
+
+  bins_view() = default;
+  bins_view(const Bin* p, size_type n) noexcept: _p(p), _n(n) { }
+
+  size_type size() const noexcept { return _n; }
+  const Bin* data() const noexcept { return _p; }
+  const Bin& operator[](size_type i) const noexcept { return _p[i]; }
+  const Bin* begin() const noexcept { return _p; }
+  const Bin*   end() const noexcept { return _p+_n; }
+};
+
+template <typename AxesSpecs> struct view_specs;
+template <typename... Ax> struct view_specs<std::tuple<Ax...>> {
+  using type = std::tuple< axis_spec<
+    variant_axis<typename std::decay_t<typename Ax::axis>::edge_type>,
+    Ax::under::value, Ax::over::value, Ax::excep::value >... >;
+};
+
+}} // end namespace detail::snapshot
+
+// Write hist to filename. The file is written under a temporary name
+// and renamed, so readers never see a partial snapshot.
+template <typename Bin, typename... Ax, typename Container, typename Filler>
+void write_snapshot(
+  const std::string& filename,
+  const binner<Bin,std::tuple<Ax...>,Container,Filler>& hist
+) {
+  using namespace detail::snapshot;
+  using hist_type = binner<Bin,std::tuple<Ax...>,Container,Filler>;
+  using value_type = typename hist_type::value_type;
+  static_assert(std::is_trivially_copyable<value_type>::value,
+    "snapshot bins must be trivially copyable");
+
+  std::vector<char> axes;
+  write_axes<std::tuple<Ax...>>(axes,hist.axes(),
+    std::index_sequence_for<Ax...>());
+
+  header h { };
+  std::copy(magic, magic+8, h.magic);
+  h.version = version;
+  h.naxes = sizeof...(Ax);
+  h.bin_size = sizeof(value_type);
+  h.bin_type = type_tag<value_type>();
+  h.nbins = hist.nbins_total();
+  h.axes_size = axes.size();
+  h.payload = align(sizeof(h) + axes.size());
+  axes.resize(h.payload - sizeof(h), 0); // padding
+
+  const std::string tmp = filename + '.' + std::to_string(::getpid());
+  std::ofstream f(tmp, std::ios::binary);
+  if (!f) throw error("cannot write snapshot \"",tmp,"\"");
+  checksum sum;
+  sum.update(axes.data(),axes.size());
+  f.write(reinterpret_cast<const char*>(&h),sizeof(h));
+  f.write(axes.data(),axes.size());
+
+  // bins are copied through a buffer, for containers of proxies
+  std::vector<value_type> buf;
+  buf.reserve(std::min<size_t>(h.nbins,IVANP_BINNER_BATCH_SIZE));
+  const auto write_buf = [&]{
+    sum.update(buf.data(),buf.size()*sizeof(value_type));
+    f.write(reinterpret_cast<const char*>(buf.data()),
+      buf.size()*sizeof(value_type));
+    buf.clear();
+  };
+  for (const auto& bin : hist.bins()) {
+    buf.emplace_back(bin);
+    if (buf.size() == buf.capacity()) write_buf();
+  }
+  write_buf();
+
+  h.checksum = sum.digest();
+  f.seekp(0);
+  f.write(reinterpret_cast<const char*>(&h),sizeof(h));
+  f.close();
+  if (!f || std::rename(tmp.c_str(), filename.c_str())) {
+    std::remove(tmp.c_str());
+    throw error("cannot write snapshot \"",filename,"\"");
+  }
+}
+
+// Untyped snapshot, mmapped read-only.
+// The header, sizes and, if verify is true, the checksum are validated.
+class snapshot_file {
+  mem_file _mem;
+  detail::snapshot::header _h;
+
+public:
+  explicit snapshot_file(const std::string& name, bool verify = true)
+  : _mem(mem_file::mmap(name.c_str())) {
+    using namespace detail::snapshot;
+    const char* m = _mem.mem();
+    const size_t len = _mem.size();
+    if (len < sizeof(_h)) throw error(
+      "snapshot \"",name,"\": file too short");
+    std::memcpy(&_h,m,sizeof(_h));
+    if (!std::equal(magic, magic+8, _h.magic)) throw error(
+      "snapshot \"",name,"\": not a binner snapshot");
+    if (_h.version != version) throw error(
+      "snapshot \"",name,"\": unsupported version ",_h.version);
+    if (_h.payload != align(sizeof(_h)+_h.axes_size)
+      || len != _h.payload + _h.nbins*_h.bin_size) throw error(
+      "snapshot \"",name,"\": inconsistent size");
+    if (verify) {
+      checksum sum;
+      sum.update(m+sizeof(_h),len-sizeof(_h));
+      if (sum.digest() != _h.checksum) throw error(
+        "snapshot \"",name,"\": checksum mismatch");
+    }
+  }
+
+  const detail::snapshot::header& header() const noexcept { return _h; }
+  uint64_t naxes() const noexcept { return _h.naxes; }
+  uint64_t nbins() const noexcept { return _h.nbins; }
+  uint64_t bin_size() const noexcept { return _h.bin_size; }
+  uint64_t bin_type() const noexcept { return _h.bin_type; }
+
+  // axes records followed by padding up to the payload
+  const char* axes() const noexcept
+  { return _mem.mem()+sizeof(detail::snapshot::header); }
+  size_t axes_size() const noexcept { return _h.axes_size; }
+  const char* payload() const noexcept { return _mem.mem()+_h.payload; }
+
+  // same binning and bin type
+  bool compatible(const snapshot_file& o) const noexcept {
+    return _h.naxes == o._h.naxes && _h.bin_size == o._h.bin_size
+        && _h.bin_type == o._h.bin_type
+        && _h.nbins == o._h.nbins && _h.axes_size == o._h.axes_size
+        && !std::memcmp(axes(),o.axes(),_h.axes_size);
+  }
+};
+
+// Snapshot of a binner of type Binner, mmapped read-only.
+// *snapshot is a binner with the same bin type and axis specs, its axes
+// are variant_axis and its bins are read in place from the mapping.
+template <typename Binner>
+class snapshot {
+public:
+  using source_type = Binner;
+  using bin_type = typename source_type::value_type;
+  using view_type = binner< bin_type,
+    typename detail::snapshot::view_specs<
+      typename source_type::axes_specs>::type,
+    detail::snapshot::bins_view<bin_type> >;
+  static constexpr unsigned naxes = source_type::naxes;
+
+private:
+  snapshot_file _file;
+  view_type _view;
+
+  template <unsigned I>
+  static typename view_type::template axis_type<I> read_axis(
+    const char*& p, const char* end, const std::string& name
+  ) {
+    using namespace detail::snapshot;
+    using spec = typename source_type::template axis_spec<I>;
+    using axis = typename view_type::template axis_type<I>;
+    using edge_type = typename axis::edge_type;
+    if (size_t(end-p) < sizeof(axis_record)) throw error(
+      "snapshot \"",name,"\": truncated axes");
+    axis_record r;
+    std::memcpy(&r,p,sizeof(r));
+    p += sizeof(r);
+    if ( r.under != spec::under::value || r.over != spec::over::value
+      || r.excep != spec::excep::value ) throw error(
+      "snapshot \"",name,"\": axis ",I," specs do not match");
+    if ( r.edge_kind != edge_kind<edge_type>()
+      || r.edge_size != sizeof(edge_type) ) throw error(
+      "snapshot \"",name,"\": axis ",I," edge type does not match");
+    const size_t n = r.uniform ? 2 : r.nbins+1;
+    if (size_t(end-p)/sizeof(edge_type) < n) throw error(
+      "snapshot \"",name,"\": truncated axes");
+    std::vector<edge_type> edges(n);
+    std::memcpy(edges.data(),p,n*sizeof(edge_type));
+    p += n*sizeof(edge_type);
+    if (r.uniform)
+      return axis(axis_size_type(r.nbins), edges[0], edges[1]);
+    return axis(std::move(edges));
+  }
+
+  template <size_t... I>
+  static view_type make_view(
+    const snapshot_file& f, const std::string& name, std::index_sequence<I...>
+  ) {
+    if ( f.naxes() != naxes || f.bin_size() != sizeof(bin_type)
+      || f.bin_type() != detail::snapshot::type_tag<bin_type>() ) throw error(
+      "snapshot \"",name,"\": binner type does not match");
+
+    const char *p = f.axes(), *end = p+f.axes_size();
+    // braced init list, axes are read in order
+    typename view_type::axes_tuple axes { read_axis<I>(p,end,name)... };
+    view_type view(std::move(axes), detail::snapshot::bins_view<bin_type>(
+      reinterpret_cast<const bin_type*>(f.payload()), f.nbins()));
+    if (view.nbins_total() != f.nbins()) throw error(
+      "snapshot \"",name,"\": number of bins does not match axes");
+    return view;
+  }
+
+public:
+  explicit snapshot(const std::string& filename, bool verify = true)
+  : _file(filename,verify),
+    _view(make_view(_file,filename,std::make_index_sequence<naxes>())) { }
+
+  const view_type& operator*() const noexcept { return _view; }
+  const view_type* operator->() const noexcept { return &_view; }
+  const view_type& get() const noexcept { return _view; }
+};
+
+} // end namespace ivanp
+
+#endif
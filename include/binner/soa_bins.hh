@@ -0,0 +1,192 @@
+#ifndef IVANP_BINNER_SOA_BINS_HH
+#define IVANP_BINNER_SOA_BINS_HH
+
+// Struct-of-arrays container for weighted bins.
+// Each field (w, w2, n) is kept in its own contiguous array.
+// Elements are accessed through proxies with reference members,
+// so fillers and exporters written for weight_bin work unchanged.
+//
+//   using bin = ivanp::weight_bin<>;
+//   ivanp::binner<bin, axes, ivanp::soa_weights<>> hist(...);
+
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+#include <stdexcept>
+
+namespace ivanp {
+
+template <typename T = double, typename N = unsigned long>
+struct weight_bin {
+  T w = 0, w2 = 0;
+  N n = 0;
+
+  weight_bin& operator()(T weight) noexcept {
+    w += weight;
+    w2 += weight*weight;
+    ++n;
+    return *this;
+  }
+  weight_bin& operator()() noexcept { return (*this)(T(1)); }
+
+  template <typename B, typename = decltype(std::declval<const B&>().w2)>
+  weight_bin& operator+=(const B& o) noexcept {
+    w += o.w;
+    w2 += o.w2;
+    n += o.n;
+    return *this;
+  }
+};
+
+// T and N are const for the const proxy
+template <typename T, typename N>
+struct soa_weight_ref {
+  using value_type = weight_bin<std::remove_const_t<T>,std::remove_const_t<N>>;
+  T& w;
+  T& w2;
+  N& n;
+
+  const soa_weight_ref& operator()(T weight) const noexcept {
+    w += weight;
+    w2 += weight*weight;
+    ++n;
+    return *this;
+  }
+  const soa_weight_ref& operator()() const noexcept { return (*this)(T(1)); }
+
+  template <typename B, typename = decltype(std::declval<const B&>().w2)>
+  const soa_weight_ref& operator+=(const B& o) const noexcept {
+    w += o.w;
+    w2 += o.w2;
+    n += o.n;
+    return *this;
+  }
+
+  operator value_type() const noexcept { return { w, w2, n }; }
+};
+
+template <typename T = double, typename N = unsigned long>
+class soa_weights {
+public:
+  using value_type = weight_bin<T,N>;
+  using reference = soa_weight_ref<T,N>;
+  using const_reference = soa_weight_ref<const T,const N>;
+  using size_type = std::size_t;
+
+private:
+  std::vector<T> _w, _w2;
+  std::vector<N> _n;
+
+  template <typename U>
+  static void add(U* __restrict a, const U* __restrict b, size_type n)
+  noexcept { for (size_type i=0; i<n; ++i) a[i] += b[i]; }
+
+  template <bool Const>
+  class basic_iterator {
+    using container = std::conditional_t<Const,const soa_weights,soa_weights>;
+    container* _c;
+    std::ptrdiff_t _i;
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = soa_weights::value_type;
+    using difference_type = std::ptrdiff_t;
+    using reference = std::conditional_t<Const,
+      soa_weights::const_reference, soa_weights::reference>;
+    using pointer = void;
+
+    basic_iterator(): _c(nullptr), _i(0) { }
+    basic_iterator(container* c, difference_type i): _c(c), _i(i) { }
+    operator basic_iterator<true>() const noexcept { return { _c, _i }; }
+
+    reference operator*() const noexcept { return (*_c)[_i]; }
+    reference operator[](difference_type d) const noexcept
+    { return (*_c)[_i+d]; }
+
+    basic_iterator& operator++() noexcept { ++_i; return *this; }
+    basic_iterator& operator--() noexcept { --_i; return *this; }
+    basic_iterator operator++(int) noexcept { return { _c, _i++ }; }
+    basic_iterator operator--(int) noexcept { return { _c, _i-- }; }
+    basic_iterator& operator+=(difference_type d) noexcept
+    { _i += d; return *this; }
+    basic_iterator& operator-=(difference_type d) noexcept
+    { _i -= d; return *this; }
+    basic_iterator operator+(difference_type d) const noexcept
+    { return { _c, _i+d }; }
+    basic_iterator operator-(difference_type d) const noexcept
+    { return { _c, _i-d }; }
+    difference_type operator-(const basic_iterator& o) const noexcept
+    { return _i - o._i; }
+
+    bool operator==(const basic_iterator& o) const noexcept
+    { return _i == o._i; }
+    bool operator!=(const basic_iterator& o) const noexcept
+    { return _i != o._i; }
+    bool operator< (const basic_iterator& o) const noexcept
+    { return _i <  o._i; }
+  };
+
+public:
+  using iterator = basic_iterator<false>;
+  using const_iterator = basic_iterator<true>;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  soa_weights() = default;
+  explicit soa_weights(size_type n): _w(n), _w2(n), _n(n) { }
+
+  inline size_type size() const noexcept { return _w.size(); }
+
+  inline reference operator[](size_type i) noexcept
+  { return { _w[i], _w2[i], _n[i] }; }
+  inline const_reference operator[](size_type i) const noexcept
+  { return { _w[i], _w2[i], _n[i] }; }
+
+  // contiguous fields
+  inline const std::vector<T>& w () const noexcept { return _w;  }
+  inline const std::vector<T>& w2() const noexcept { return _w2; }
+  inline const std::vector<N>& n () const noexcept { return _n;  }
+
+  // Zeroes all bins, the size is kept
+  void clear() noexcept {
+    std::fill(_w .begin(),_w .end(),T(0));
+    std::fill(_w2.begin(),_w2.end(),T(0));
+    std::fill(_n .begin(),_n .end(),N(0));
+  }
+
+  // bins [i,i+n) += bins [j,j+n), one contiguous loop per field.
+  // The ranges must not overlap.
+  void add_range(size_type i, size_type j, size_type n) noexcept {
+    add(_w .data()+i,_w .data()+j,n);
+    add(_w2.data()+i,_w2.data()+j,n);
+    add(_n .data()+i,_n .data()+j,n);
+  }
+
+  soa_weights& add_bins(const soa_weights& o) {
+    const size_type size = _w.size();
+    if (size != o._w.size()) throw std::length_error(
+      "soa_weights::add_bins: sizes do not match");
+    for (size_type i=0; i<size; ++i) _w [i] += o._w [i];
+    for (size_type i=0; i<size; ++i) _w2[i] += o._w2[i];
+    for (size_type i=0; i<size; ++i) _n [i] += o._n [i];
+    return *this;
+  }
+
+  iterator begin() noexcept { return { this, 0 }; }
+  iterator   end() noexcept { return { this, std::ptrdiff_t(size()) }; }
+  const_iterator begin() const noexcept { return { this, 0 }; }
+  const_iterator   end() const noexcept
+  { return { this, std::ptrdiff_t(size()) }; }
+
+  reverse_iterator rbegin() noexcept { return reverse_iterator(end()); }
+  reverse_iterator   rend() noexcept { return reverse_iterator(begin()); }
+  const_reverse_iterator rbegin() const noexcept
+  { return const_reverse_iterator(end()); }
+  const_reverse_iterator   rend() const noexcept
+  { return const_reverse_iterator(begin()); }
+};
+
+} // end namespace ivanp
+
+#endif
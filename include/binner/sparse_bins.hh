@@ -0,0 +1,175 @@
+#ifndef IVANP_BINNER_SPARSE_BINS_HH
+#define IVANP_BINNER_SPARSE_BINS_HH
+
+// Sparse bin container for binners with mostly empty bins.
+// Occupied bins are kept in an open-addressing hash table keyed by the
+// flat bin index, so memory scales with the number of filled bins.
+// Non-const operator[] inserts a bin, const operator[] returns an empty
+// bin for indices that were never filled, find() returns nullptr for them.
+// Read through the const overloads to avoid filling the table with
+// empty bins.
+// Iteration visits every index in order, as for a dense container.
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+
+#include "ivanp/binner/axis.hh"
+
+namespace ivanp {
+
+template <typename Bin>
+class sparse_bins {
+public:
+  using value_type = Bin;
+  using size_type = ivanp::axis_size_type;
+  using occupied_type = std::vector<std::pair<size_type,const Bin*>>;
+
+private:
+  // wider than any index, so the empty key is never a valid index
+  using key_type = std::uint64_t;
+  static constexpr key_type empty_key = key_type(-1);
+
+  size_type _size = 0, _n = 0;
+  std::vector<key_type> _keys;
+  std::vector<Bin> _vals;
+  Bin _empty { };
+
+  inline size_t slot(key_type key) const noexcept {
+    // splitmix64 finalizer, so that all key bits reach the masked bits;
+    // capacity is a power of 2
+    key ^= key >> 30; key *= 0xbf58476d1ce4e5b9ull;
+    key ^= key >> 27; key *= 0x94d049bb133111ebull;
+    key ^= key >> 31;
+    return size_t(key) & (_keys.size()-1);
+  }
+
+  size_t find_slot(key_type key) const noexcept {
+    const size_t mask = _keys.size()-1;
+    size_t s = slot(key);
+    while (_keys[s]!=key && _keys[s]!=empty_key) s = (s+1) & mask;
+    return s;
+  }
+
+  void rehash(size_t cap) {
+    std::vector<key_type> keys(cap,empty_key);
+    std::vector<Bin> vals(cap);
+    keys.swap(_keys);
+    vals.swap(_vals);
+    for (size_t i=0, n=keys.size(); i<n; ++i) {
+      if (keys[i]==empty_key) continue;
+      const size_t s = find_slot(keys[i]);
+      _keys[s] = keys[i];
+      _vals[s] = std::move(vals[i]);
+    }
+  }
+
+public:
+  sparse_bins() = default;
+  explicit sparse_bins(size_type n): _size(n) { }
+
+  inline size_type size() const noexcept { return _size; }
+  inline size_type noccupied() const noexcept { return _n; }
+
+  void clear() {
+    _keys.clear();
+    _vals.clear();
+    _n = 0;
+  }
+
+  Bin& operator[](size_type i) {
+    if (2*size_t(_n+1) > _keys.size())
+      rehash(_keys.size() ? 2*_keys.size() : 16);
+    const size_t s = find_slot(i);
+    if (_keys[s]==empty_key) {
+      _keys[s] = i;
+      ++_n;
+    }
+    return _vals[s];
+  }
+  const Bin& operator[](size_type i) const noexcept {
+    const Bin* b = find(i);
+    return b ? *b : _empty;
+  }
+  const Bin* find(size_type i) const noexcept {
+    if (!_n) return nullptr;
+    const size_t s = find_slot(i);
+    return _keys[s]==empty_key ? nullptr : &_vals[s];
+  }
+
+  // occupied bins, sorted by index
+  occupied_type occupied() const {
+    occupied_type bins;
+    bins.reserve(_n);
+    for (size_t i=0, n=_keys.size(); i<n; ++i)
+      if (_keys[i]!=empty_key) bins.emplace_back(_keys[i],&_vals[i]);
+    std::sort(bins.begin(),bins.end(),
+      [](const auto& a, const auto& b){ return a.first < b.first; });
+    return bins;
+  }
+
+  sparse_bins& add_bins(const sparse_bins& o) {
+    if (_size != o._size) throw std::length_error(
+      "sparse_bins::add_bins: sizes do not match");
+    for (size_t i=0, n=o._keys.size(); i<n; ++i)
+      if (o._keys[i]!=empty_key) (*this)[o._keys[i]] += o._vals[i];
+    return *this;
+  }
+
+  // dense iteration in index order ---------------------------------
+  class const_iterator {
+    std::shared_ptr<const occupied_type> _occ;
+    const Bin* _empty;
+    size_type _i, _pos;
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Bin;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Bin*;
+    using reference = const Bin&;
+
+    const_iterator(): _occ(), _empty(nullptr), _i(0), _pos(0) { }
+    const_iterator(std::shared_ptr<const occupied_type> occ,
+      const Bin* empty, size_type i
+    ): _occ(std::move(occ)), _empty(empty), _i(i), _pos(0) { }
+
+    inline bool at_occupied() const noexcept {
+      return _occ && _pos < _occ->size() && (*_occ)[_pos].first == _i;
+    }
+    inline reference operator*() const noexcept {
+      return at_occupied() ? *(*_occ)[_pos].second : *_empty;
+    }
+    inline pointer operator->() const noexcept { return &**this; }
+    inline const_iterator& operator++() noexcept {
+      if (at_occupied()) ++_pos;
+      ++_i;
+      return *this;
+    }
+    inline const_iterator operator++(int) noexcept {
+      auto tmp = *this;
+      ++*this;
+      return tmp;
+    }
+    inline size_type index() const noexcept { return _i; }
+    inline bool operator==(const const_iterator& o) const noexcept
+    { return _i == o._i; }
+    inline bool operator!=(const const_iterator& o) const noexcept
+    { return _i != o._i; }
+  };
+  using iterator = const_iterator;
+
+  const_iterator begin() const {
+    return { std::make_shared<const occupied_type>(occupied()), &_empty, 0 };
+  }
+  const_iterator end() const { return { nullptr, &_empty, _size }; }
+};
+
+template <typename Bin>
+constexpr typename sparse_bins<Bin>::key_type sparse_bins<Bin>::empty_key;
+
+} // end namespace ivanp
+
+#endif
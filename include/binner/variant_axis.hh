@@ -0,0 +1,122 @@
+#ifndef IVANP_VARIANT_AXIS_HH
+#define IVANP_VARIANT_AXIS_HH
+
+// Binner axis whose type is chosen at runtime.
+// Unlike the axes in axis.hh, it needs C++17 for std::variant.
+
+#include <vector>
+#include <variant>
+#include <utility>
+#include <type_traits>
+
+#include "ivanp/binner/axis.hh"
+
+#ifndef IVANP_VARIANT_AXIS_LUT_MIN
+#define IVANP_VARIANT_AXIS_LUT_MIN 64
+#endif
+
+namespace ivanp {
+
+// Axis chosen at runtime from a closed set of types:
+// uniform, or variable bins searched with or without a lookup table.
+// Unlike ref_axis, find_bins switches on the type once per batch,
+// and the concrete lookups are inlined.
+template <typename EdgeType, bool Inherit>
+class variant_axis final: public std::conditional_t<Inherit,
+  abstract_axis<EdgeType>, axis_base>
+{
+public:
+  using base_type = std::conditional_t<Inherit,
+    abstract_axis<EdgeType>, axis_base>;
+  using edge_type = EdgeType;
+  using edge_ptype = edge_proxy<edge_type>;
+  using size_type = ivanp::axis_size_type;
+  using uniform_type = uniform_axis<edge_type>;
+  using container_type = container_axis<std::vector<edge_type>>;
+  using lut_type = container_axis<std::vector<edge_type>,false,true>;
+  enum kind_type : char { uniform, container, lut };
+
+private:
+  std::variant<uniform_type,container_type,lut_type> _axis;
+
+  template <typename F>
+  inline decltype(auto) visit(F&& f) const {
+    return std::visit(std::forward<F>(f),_axis);
+  }
+
+  void assign(std::vector<edge_type>&& edges) {
+    if (edges.size() > IVANP_VARIANT_AXIS_LUT_MIN)
+      _axis.template emplace<lut_type>(std::move(edges));
+    else
+      _axis.template emplace<container_type>(std::move(edges));
+  }
+
+  template <typename A>
+  using detect_is_uniform = decltype(std::declval<const A&>().is_uniform());
+
+public:
+  variant_axis() = default;
+  variant_axis(const uniform_type& a): _axis(a) { }
+  variant_axis(const container_type& a): _axis(a) { }
+  variant_axis(const lut_type& a): _axis(a) { }
+  variant_axis(size_type nbins, edge_type min, edge_type max)
+  : _axis(std::in_place_type<uniform_type>,nbins,min,max) { }
+  // with a lookup table if there are many edges
+  variant_axis(std::vector<edge_type> edges) { assign(std::move(edges)); }
+
+  // copies the binning of any other axis, e.g. a ref_axis from re_axes
+  template <typename A, typename = detect_is_uniform<A>>
+  explicit variant_axis(const A& a) {
+    if (a.is_uniform()) {
+      _axis.template emplace<uniform_type>(a.nbins(),a.min(),a.max());
+    } else {
+      const size_type n = a.nedges();
+      std::vector<edge_type> edges;
+      edges.reserve(n);
+      for (size_type i=0; i<n; ++i) edges.emplace_back(a.edge(i));
+      assign(std::move(edges));
+    }
+  }
+
+  inline kind_type kind() const noexcept { return kind_type(_axis.index()); }
+
+  inline size_type nedges() const noexcept
+  { return visit([](const auto& a){ return a.nedges(); }); }
+  inline size_type nbins () const noexcept
+  { return visit([](const auto& a){ return a.nbins(); }); }
+
+  inline edge_type edge(size_type i) const noexcept
+  { return visit([i](const auto& a){ return a.edge(i); }); }
+  inline edge_type min() const noexcept
+  { return visit([](const auto& a){ return a.min(); }); }
+  inline edge_type max() const noexcept
+  { return visit([](const auto& a){ return a.max(); }); }
+  inline edge_ptype lower(size_type i) const noexcept
+  { return visit([i](const auto& a){ return a.lower(i); }); }
+  inline edge_ptype upper(size_type i) const noexcept
+  { return visit([i](const auto& a){ return a.upper(i); }); }
+
+  template <typename T>
+  inline size_type find_bin(const T& x) const noexcept
+  { return visit([&x](const auto& a){ return a.find_bin(x); }); }
+  inline size_type vfind_bin(edge_type x) const noexcept
+  { return find_bin(x); }
+
+  template <typename T>
+  void find_bins(size_type n, const T* x, size_type* bins) const noexcept {
+    visit([=](const auto& a){ a.find_bins(n,x,bins); });
+  }
+  inline void vfind_bins(size_type n, const edge_type* x, size_type* bins)
+  const noexcept { find_bins(n,x,bins); }
+
+  template <typename T>
+  inline size_type operator[](const T& x) const noexcept
+  { return find_bin(x); }
+
+  inline bool is_uniform() const noexcept
+  { return std::holds_alternative<uniform_type>(_axis); }
+};
+
+} // end namespace ivanp
+
+#endif
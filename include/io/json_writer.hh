@@ -0,0 +1,139 @@
+#ifndef IVANP_IO_JSON_WRITER_HH
+#define IVANP_IO_JSON_WRITER_HH
+
+// Buffered writer for large JSON outputs.
+// Numbers are formatted directly into a reusable buffer, which is
+// written out in large chunks to an ostream or a file descriptor.
+// Floating point numbers are written in the shortest form that reads
+// back to the same value.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <ostream>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+#include <unistd.h>
+
+#if __cplusplus >= 201703L && __has_include(<charconv>)
+#include <charconv>
+#endif
+
+#include "ivanp/error.hh"
+
+#ifndef IVANP_JSON_BUFFER_SIZE
+#define IVANP_JSON_BUFFER_SIZE (1u<<20)
+#endif
+
+namespace ivanp {
+
+class json_writer {
+  std::vector<char> _buf;
+  char *_p, *_end;
+  std::ostream* _os;
+  int _fd;
+
+  // space for any single number
+  static constexpr size_t max_number_size = 32;
+
+  inline void reserve(size_t n) { if (size_t(_end-_p) < n) flush(); }
+
+  template <typename T>
+  static char* format_int(char* p, T x) noexcept {
+    char tmp[24];
+    char* t = tmp+sizeof(tmp);
+    using U = std::make_unsigned_t<T>;
+    U u = x;
+    if (std::is_signed<T>::value && x < T(0)) { *p++ = '-'; u = U(0) - u; }
+    do { *--t = char('0' + u%10); u /= 10; } while (u);
+    const size_t n = tmp+sizeof(tmp)-t;
+    std::memcpy(p,t,n);
+    return p+n;
+  }
+
+  template <typename T>
+  static char* format_float(char* p, T x) noexcept {
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    return std::to_chars(p,p+max_number_size,x).ptr;
+#else
+    // the first precision that round-trips
+    for (int prec = std::is_same<T,float>::value ? 6 : 15; ; ++prec) {
+      const int n = std::snprintf(p,max_number_size,"%.*g",prec,double(x));
+      if (prec >= 17 || T(std::strtod(p,nullptr)) == x) return p+n;
+    }
+#endif
+  }
+
+public:
+  explicit json_writer(std::ostream& os,
+    size_t buffer_size = IVANP_JSON_BUFFER_SIZE
+  ): _buf(std::max(buffer_size,max_number_size)),
+     _p(_buf.data()), _end(_p+_buf.size()), _os(&os), _fd(-1) { }
+  explicit json_writer(int fd,
+    size_t buffer_size = IVANP_JSON_BUFFER_SIZE
+  ): _buf(std::max(buffer_size,max_number_size)),
+     _p(_buf.data()), _end(_p+_buf.size()), _os(nullptr), _fd(fd) { }
+  json_writer(const json_writer&) = delete;
+  json_writer& operator=(const json_writer&) = delete;
+  ~json_writer() { try { flush(); } catch (...) { } }
+
+  void flush() {
+    const char* p = _buf.data();
+    size_t n = _p - p;
+    _p = _buf.data();
+    if (_os) {
+      _os->write(p,n);
+      return;
+    }
+    while (n) {
+      const ssize_t m = ::write(_fd,p,n);
+      if (m < 0) {
+        if (errno == EINTR) continue;
+        throw error("json_writer: write: ",std::strerror(errno));
+      }
+      p += m;
+      n -= m;
+    }
+  }
+
+  json_writer& write(const char* s, size_t n) {
+    for (;;) {
+      const size_t m = std::min<size_t>(n,_end-_p);
+      _p = std::copy(s,s+m,_p);
+      if (!(n -= m)) break;
+      s += m;
+      flush();
+    }
+    return *this;
+  }
+
+  json_writer& operator<<(char c) {
+    reserve(1);
+    *_p++ = c;
+    return *this;
+  }
+  json_writer& operator<<(const char* s) { return write(s,std::strlen(s)); }
+  json_writer& operator<<(bool x) { return x ? write("true",4)
+                                             : write("false",5); }
+
+  template <typename T>
+  std::enable_if_t<std::is_integral<T>::value, json_writer&>
+  operator<<(T x) {
+    reserve(max_number_size);
+    _p = format_int(_p,x);
+    return *this;
+  }
+  template <typename T>
+  std::enable_if_t<std::is_floating_point<T>::value, json_writer&>
+  operator<<(T x) {
+    reserve(max_number_size);
+    _p = format_float(_p,x);
+    return *this;
+  }
+};
+
+} // end namespace ivanp
+
+#endif
@@ -76,6 +76,9 @@ public:
     return *this;
   }
 
+  // number of set substring pairs, 1 + highest matched group
+  unsigned size() const noexcept { return n; }
+
   iterator begin() const { return { subs, orig }; }
   iterator end() const { return { subs+n*2, orig }; }
 
@@ -89,16 +92,27 @@ class regex {
   ::pcre_extra* extra;
 
 public:
-  regex(const char* expr, int options=0): compiled(nullptr), extra(nullptr) {
+#ifdef PCRE_STUDY_JIT_COMPILE
+  static constexpr int default_study = PCRE_STUDY_JIT_COMPILE;
+#else
+  static constexpr int default_study = 0;
+#endif
+
+  regex(const char* expr, int options=0, int study=default_study)
+  : compiled(nullptr), extra(nullptr) {
     const char* err_str;
     int err_offset;
     compiled = pcre_compile(expr,options,&err_str,&err_offset,nullptr);
     if (!compiled) throw error("pcre_compile: ",expr,": ",err_str);
-    extra = pcre_study(compiled,0,&err_str); // optimize
-    if (err_str) throw error("pcre_study: ",expr,": ",err_str);
+    extra = pcre_study(compiled,study,&err_str); // optimize
+    if (err_str) {
+      pcre_free(compiled);
+      compiled = nullptr;
+      throw error("pcre_study: ",expr,": ",err_str);
+    }
   }
-  regex(const std::string& expr, int options=0)
-  : regex(expr.c_str(),options) { }
+  regex(const std::string& expr, int options=0, int study=default_study)
+  : regex(expr.c_str(),options,study) { }
 
   regex(const regex&) = delete;
   regex& operator=(const regex&) = delete;
@@ -123,6 +137,12 @@ public:
     }
   }
 
+  int capture_count() const {
+    int n = 0;
+    pcre_fullinfo(compiled,extra,PCRE_INFO_CAPTURECOUNT,&n);
+    return n;
+  }
+
   bool operator()(match& m, const char* str, size_t len = 0) {
     if (!len) len = strlen(str);
     const int rc = pcre_exec(
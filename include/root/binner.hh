@@ -2,8 +2,10 @@
 #define IVANP_BINNER_ROOT_HH
 
 #include <sstream>
+#include <algorithm>
 
 #include "ivanp/binner/slice.hh"
+#include "ivanp/binner/sharded.hh"
 
 namespace ivanp {
 namespace root {
@@ -140,22 +142,45 @@ public:
 
 template <bool Use, bool Uf, typename Bins, typename F>
 inline std::enable_if_t<!Use> set_weight(TH1* h, const Bins& bins, F get) { }
+// struct-of-arrays bins with the default converter are copied directly
+template <typename Bins>
+using detect_soa_fields = decltype(std::declval<const Bins&>().w2());
+template <typename Bins, typename F>
+using soa_fields = std::integral_constant<bool,
+  is_detected<detect_soa_fields,Bins>::value &&
+  std::is_same<F,bin_converter<typename Bins::value_type>>::value >;
+
 template <bool Use, bool Uf, typename Bins, typename F>
-inline std::enable_if_t<Use> set_weight(TH1* h, const Bins& bins, F get) {
+inline std::enable_if_t<Use && !soa_fields<Bins,F>::value>
+set_weight(TH1* h, const Bins& bins, F get) {
   Double_t *val = dynamic_cast<TArrayD*>(h)->GetArray();
   size_t i = !Uf;
   for (const auto& bin : bins) { val[i] = get.val(bin); ++i; }
 }
+template <bool Use, bool Uf, typename Bins, typename F>
+inline std::enable_if_t<Use && soa_fields<Bins,F>::value>
+set_weight(TH1* h, const Bins& bins, F get) {
+  Double_t *val = dynamic_cast<TArrayD*>(h)->GetArray();
+  std::copy(bins.w().begin(),bins.w().end(),val+!Uf);
+}
 
 template <bool Use, bool Uf, typename Bins, typename F>
 inline std::enable_if_t<!Use> set_sumw2(TH1* h, const Bins& bins, F get) { }
 template <bool Use, bool Uf, typename Bins, typename F>
-inline std::enable_if_t<Use> set_sumw2(TH1* h, const Bins& bins, F get) {
+inline std::enable_if_t<Use && !soa_fields<Bins,F>::value>
+set_sumw2(TH1* h, const Bins& bins, F get) {
   h->Sumw2();
   Double_t *err2 = h->GetSumw2()->GetArray();
   size_t i = !Uf;
   for (const auto& bin : bins) { err2[i] = get.err2(bin); ++i; }
 }
+template <bool Use, bool Uf, typename Bins, typename F>
+inline std::enable_if_t<Use && soa_fields<Bins,F>::value>
+set_sumw2(TH1* h, const Bins& bins, F get) {
+  h->Sumw2();
+  Double_t *err2 = h->GetSumw2()->GetArray();
+  std::copy(bins.w2().begin(),bins.w2().end(),err2+!Uf);
+}
 
 template <bool Use, typename Bins, typename F>
 inline std::enable_if_t<!Use> set_num(TH1* h, const Bins& bins, F get) { }
@@ -170,7 +195,8 @@ template <typename... Args>
 class last_is_empty {
   template <typename Last, typename = void> struct impl : std::false_type { };
   template <typename Last>
-  struct impl<Last, std::enable_if_t< std::is_empty<Last>::value > >
+  struct impl<Last,
+    std::enable_if_t< std::is_empty<std::decay_t<Last>>::value > >
   : std::true_type { };
 public:
   static constexpr bool value = impl<
@@ -207,9 +233,10 @@ auto* to_root(
   return h;
 };
 
-template <size_t D, typename Bin, typename... Ax, typename... Args>
+template <size_t D, typename Bin, typename... Ax, typename Container,
+          typename... Args>
 auto to_root(
-  const binner_slice<D, Bin, std::tuple<Ax...>>& hist,
+  const binner_slice<D, Bin, std::tuple<Ax...>, Container>& hist,
   const std::string& name, Args&&... args
 ) -> std::enable_if_t<
   detail::last_is_empty<Args...>::value, detail::TH_t<D>*
@@ -222,9 +249,10 @@ auto to_root(
   return to_root(*hist,ss.str(),std::get<sizeof...(Args)-1>(args_tup));
 };
 
-template <size_t D, typename Bin, typename... Ax, typename... Args>
+template <size_t D, typename Bin, typename... Ax, typename Container,
+          typename... Args>
 auto to_root(
-  const binner_slice<D, Bin, std::tuple<Ax...>>& hist,
+  const binner_slice<D, Bin, std::tuple<Ax...>, Container>& hist,
   const std::string& name, Args&&... args
 ) -> std::enable_if_t<
   !detail::last_is_empty<Args...>::value, detail::TH_t<D>*
@@ -261,6 +289,124 @@ auto slice_to_root(
   return hh;
 }
 
+namespace detail {
+
+// bin fields, 0 if the converter does not provide them
+template <typename F, typename B>
+inline auto get_val(const F& f, const B& b, int)
+-> decltype(f.val(b),Double_t()) { return f.val(b); }
+template <typename F, typename B>
+inline Double_t get_val(const F&, const B&, long) { return 0; }
+template <typename F, typename B>
+inline auto get_err2(const F& f, const B& b, int)
+-> decltype(f.err2(b),Double_t()) { return f.err2(b); }
+template <typename F, typename B>
+inline Double_t get_err2(const F&, const B&, long) { return 0; }
+template <typename F, typename B>
+inline auto get_num(const F& f, const B& b, int)
+-> decltype(f.num(b),Double_t()) { return f.num(b); }
+template <typename F, typename B>
+inline Double_t get_num(const F&, const B&, long) { return 0; }
+
+template <typename Axes, size_t... I>
+inline size_t TH_ncells(const Axes& axes, std::index_sequence<I...>) {
+  size_t n = 1;
+  UNFOLD( n *= std::get<I>(axes).nbins()+2 )
+  return n;
+}
+
+template <size_t D, typename Hist, typename Labels, typename F>
+std::vector<TH_t<D>*> parallel_slice_to_root(
+  const Hist& hist, const std::string& name, unsigned nthreads,
+  const Labels& labels, F convert
+) {
+  using traits = bin_converter_traits<F,typename Hist::bin_type>;
+  static_assert(traits::has_weight,
+    "no weight variable found for a bin type");
+
+  const auto slices = slice<D>(hist);
+  using slice_type = typename decltype(slices)::slice_type;
+  using under = typename std::tuple_element_t<0,
+    typename slice_type::binner_type::axes_specs>::under;
+  const size_t n = slices.size();
+  std::vector<TH_t<D>*> hh(n,nullptr);
+  if (!n) return hh;
+
+  // all slices share the axes
+  const size_t ncells = TH_ncells(slices[0]->axes(),
+    std::make_index_sequence<D>());
+  std::vector<std::string> names(n);
+  std::vector<Double_t> val(traits::has_weight ? n*ncells : 0),
+                        err2(traits::has_sumw2 ? n*ncells : 0),
+                        num(n,0);
+
+  // convert slices on worker threads
+  ivanp::detail::sharded::parallel_for(n, nthreads, [&](unsigned k){
+    const auto s = slices[k];
+    std::stringstream ss;
+    ss.precision(4);
+    ss << name << s.name(labels);
+    names[k] = ss.str();
+    size_t i = k*ncells + !under::value;
+    for (const auto& bin : s->bins()) {
+      if (traits::has_weight) val [i] = get_val (convert,bin,0);
+      if (traits::has_sumw2)  err2[i] = get_err2(convert,bin,0);
+      if (traits::has_num)    num [k] += get_num(convert,bin,0);
+      ++i;
+    }
+  });
+
+  // create histograms on this thread, cloning the first one
+  hh[0] = make_TH(names[0],slices[0]->axes());
+  if (traits::has_sumw2) hh[0]->Sumw2();
+  for (size_t k=1; k<n; ++k)
+    hh[k] = static_cast<TH_t<D>*>(hh[0]->Clone(names[k].c_str()));
+  for (size_t k=0; k<n; ++k) {
+    auto* h = hh[k];
+    if (traits::has_weight)
+      std::copy(val.begin()+k*ncells, val.begin()+(k+1)*ncells,
+        dynamic_cast<TArrayD*>(h)->GetArray());
+    if (traits::has_sumw2)
+      std::copy(err2.begin()+k*ncells, err2.begin()+(k+1)*ncells,
+        h->GetSumw2()->GetArray());
+    if (traits::has_num) h->SetEntries(num[k]);
+  }
+  return hh;
+}
+
+}
+
+// Same as slice_to_root, but bin contents are converted on nthreads
+// threads. The histograms are then created on the calling thread.
+template <size_t D=1,
+          typename Bin, typename... Ax, typename Container, typename Filler,
+          typename... Args>
+auto parallel_slice_to_root(
+  const binner<Bin,std::tuple<Ax...>,Container,Filler>& hist,
+  const std::string& name, unsigned nthreads, Args&&... args
+) -> std::enable_if_t<
+  detail::last_is_empty<Args...>::value, std::vector<detail::TH_t<D>*>
+> {
+  auto&& args_tup = std::forward_as_tuple(std::forward<Args>(args)...);
+  return detail::parallel_slice_to_root<D>(hist,name,nthreads,
+    detail::forward_subtuple(
+      args_tup, std::make_index_sequence<sizeof...(Args)-1>{} ),
+    std::get<sizeof...(Args)-1>(args_tup));
+}
+
+template <size_t D=1,
+          typename Bin, typename... Ax, typename Container, typename Filler,
+          typename... Args>
+auto parallel_slice_to_root(
+  const binner<Bin,std::tuple<Ax...>,Container,Filler>& hist,
+  const std::string& name, unsigned nthreads, Args&&... args
+) -> std::enable_if_t<
+  !detail::last_is_empty<Args...>::value, std::vector<detail::TH_t<D>*>
+> {
+  return detail::parallel_slice_to_root<D>(hist,name,nthreads,
+    std::forward_as_tuple(std::forward<Args>(args)...), bin_converter<Bin>{});
+}
+
 } // end namespace root
 } // end namespace ivanp
 
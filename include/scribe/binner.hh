@@ -17,16 +17,17 @@ struct hist_trait {
   }
 };
 
-template <typename Bin, typename... Ax, typename Container, typename Filler>
-struct trait<binner<Bin,std::tuple<Ax...>,Container,Filler>>: hist_trait<Bin> {
+template <typename Hist>
+struct binner_trait: hist_trait<typename Hist::bin_type> {
 private:
-  using hist = binner<Bin,std::tuple<Ax...>,Container,Filler>;
+  using hist = Hist;
+  static constexpr unsigned naxes = hist::naxes;
   using i_t = typename hist::size_type;
   using ii_t = typename hist::index_array_type;
 
-  template <unsigned I>
+  template <unsigned I, typename F>
   static std::enable_if_t<I!=0>
-  write_bins(std::ostream& o, const hist& h, ii_t& ii) {
+  write_bins(std::ostream& o, const hist& h, ii_t& ii, F& f) {
     using spec = typename hist::template axis_spec<I-1>;
     i_t n = h.template axis<I-1>().nbins();
     scribe::write_values(o,(size_type)(n+2));
@@ -34,24 +35,35 @@ private:
     if (!spec::under::value) scribe::write_values(o,(union_index_type)0);
     for (i_t& i = std::get<I-1>(ii) = 0; i<n; ++i) {
       scribe::write_values(o,(union_index_type)(I==1?1:2));
-      write_bins<I-1>(o, h, ii);
+      write_bins<I-1>(o, h, ii, f);
     }
     if (!spec::over::value) scribe::write_values(o,(union_index_type)0);
   }
-  template <unsigned I>
+  template <unsigned I, typename F>
   static std::enable_if_t<I==0>
-  write_bins(std::ostream& o, const hist& h, ii_t& ii) {
-    scribe::write_values(o,h[ii]);
+  write_bins(std::ostream& o, const hist& h, ii_t& ii, F& f) {
+    f(o,h[ii]);
   }
 public:
-  static void write_value(std::ostream& o, const hist& h) {
-    scribe::write_values(o,(size_type)sizeof...(Ax));
+  // bins are written by f(o,bin)
+  template <typename F>
+  static void write_value(std::ostream& o, const hist& h, F f) {
+    scribe::write_values(o,(size_type)naxes);
     scribe::write_values(o,h.axes());
     ii_t ii { };
-    write_bins<sizeof...(Ax)>(o,h,ii);
+    write_bins<naxes>(o,h,ii,f);
+  }
+  static void write_value(std::ostream& o, const hist& h) {
+    write_value(o,h,[](std::ostream& o, const auto& bin){
+      scribe::write_values(o,bin);
+    });
   }
 };
 
+template <typename Bin, typename... Ax, typename Container, typename Filler>
+struct trait<binner<Bin,std::tuple<Ax...>,Container,Filler>>
+: binner_trait<binner<Bin,std::tuple<Ax...>,Container,Filler>> { };
+
 // Axes =============================================================
 
 struct lin_axis;
@@ -78,9 +90,9 @@ struct trait<list_axis> {
   }
 };
 
-template <typename Container, bool Inherit>
-struct trait<ivanp::container_axis<Container,Inherit>>: trait<list_axis> {
-  using axis = ivanp::container_axis<Container,Inherit>;
+template <typename Container, bool Inherit, bool Lut>
+struct trait<ivanp::container_axis<Container,Inherit,Lut>>: trait<list_axis> {
+  using axis = ivanp::container_axis<Container,Inherit,Lut>;
   static void write_value(std::ostream& o, const axis& a) {
     scribe::write_values(o,(union_index_type)1);
     scribe::write_values(o,a.edges());
@@ -112,6 +124,22 @@ struct trait<ivanp::ref_axis<T,Ref,Inherit>> {
     }
   }
 };
+template <typename T, bool Inherit>
+struct trait<ivanp::variant_axis<T,Inherit>> {
+  static std::string type_def() { return "[lin_axis,list_axis]"; }
+  using axis = ivanp::variant_axis<T,Inherit>;
+  static void write_value(std::ostream& o, const axis& a) {
+    if (a.is_uniform()) {
+      scribe::write_values(o,(union_index_type)0);
+      scribe::write_values(o,(size_type)a.nbins());
+      scribe::write_values(o,(double)a.min());
+      scribe::write_values(o,(double)a.max());
+    } else {
+      scribe::write_values(o,(union_index_type)1);
+      scribe::write_values(o,vector_of_edges<double>(a));
+    }
+  }
+};
 template <typename T>
 struct trait<ivanp::abstract_axis<T>> {
   static std::string type_def() { return "[lin_axis,list_axis]"; }
@@ -145,9 +173,9 @@ add_bin_types(writer& w, Args&&... args) {
   w.add_type<T>(std::forward<Args>(args)...);
 }
 
-template <typename Bin, typename E, typename... Es>
-struct trait<category_bin<Bin,E,Es...>> {
-  using type = category_bin<Bin,E,Es...>;
+template <bool Deferred, typename Bin, typename E, typename... Es>
+struct trait<basic_category_bin<Deferred,Bin,E,Es...>> {
+  using type = basic_category_bin<Deferred,Bin,E,Es...>;
 
   static std::string type_name() { return enum_traits<E>::name(); }
   static std::string type_def() {
@@ -159,7 +187,9 @@ struct trait<category_bin<Bin,E,Es...>> {
     return s.str();
   }
   static void write_value(std::ostream& o, const type& x) {
-    scribe::write_values(o,x.bins);
+    if (!Deferred) return scribe::write_values(o,x.bins);
+    scribe::write_values(o,x.total());
+    for (size_t i=1; i<x.bins.size(); ++i) scribe::write_values(o,x.bins[i]);
   }
 };
 
@@ -205,6 +235,106 @@ struct trait<nlo_bin<T>, std::enable_if_t<std::is_array<T>::value>> {
   }
 };
 
+template <typename T, size_t N, typename Count>
+struct trait<multiweight_bin<T,N,Count>> {
+  using type = multiweight_bin<T,N,Count>;
+  static std::string type_name() { return "weights"; }
+  // nw is the number of variations, needed if N is 0,
+  // e.g. add_bin_types<hist_t>(w, weights.size())
+  static std::string type_def(size_t nw = N) {
+    if (!nw) throw std::invalid_argument(
+      "multiweight_bin: number of variations not given");
+    return
+      "[\"" + trait<T>::type_name() + "#2#" + std::to_string(nw)
+      + "\",\"w\"],[\"" + trait<Count>::type_name() + "\",\"n\"]";
+  }
+  template <typename U>
+  static std::string type_def(const std::vector<U>& weights_names) {
+    std::stringstream s;
+    s << "[\"" + trait<T>::type_name() + "#2";
+    for (const auto& name : weights_names) s << "\",\"" << name;
+    s << "\"],[\"" << trait<Count>::type_name() << "\",\"n\"]";
+    return s.str();
+  }
+  static void write_value(std::ostream& o, const type& bin) {
+    write_value(o,bin,bin.nvariations());
+  }
+  // nw variations, zeros past those of the bin
+  static void write_value(std::ostream& o, const type& bin, size_t nw) {
+    for (size_t k=0; k<nw; ++k)
+      scribe::write_values(o,bin.weight(k),bin.sumw2(k));
+    scribe::write_values(o,bin.n);
+  }
+};
+
+// With the number of variations set at runtime, bins that were never
+// filled are written with as many variations as the filled ones.
+template <typename T, typename Count,
+          typename... Ax, typename Container, typename Filler>
+struct trait<binner<
+  multiweight_bin<T,0,Count>,std::tuple<Ax...>,Container,Filler>>
+: binner_trait<binner<
+    multiweight_bin<T,0,Count>,std::tuple<Ax...>,Container,Filler>>
+{
+private:
+  using hist = binner<
+    multiweight_bin<T,0,Count>,std::tuple<Ax...>,Container,Filler>;
+  using base = binner_trait<hist>;
+public:
+  using base::write_value;
+  static void write_value(std::ostream& o, const hist& h) {
+    size_t nw = 0;
+    for (const auto& bin : h) nw = std::max(nw,bin.nvariations());
+    base::write_value(o,h,[nw](std::ostream& o, const auto& bin){
+      trait<multiweight_bin<T,0,Count>>::write_value(o,bin,nw);
+    });
+  }
+};
+
+// One variation of a histogram of multiweight bins
+//
+//   add_bin_types<multiweight_hist_variation<hist_t>>(w);
+//   w("name_var3", select_variation(hist,3));
+template <typename T, typename Count>
+struct multiweight_variation_bin;
+
+template <typename T, typename Count>
+struct trait<multiweight_variation_bin<T,Count>> {
+  static std::string type_name() { return "weight"; }
+  static std::string type_def() { return
+    "[\"" + trait<T>::type_name() + "#2\",\"w\"],"
+    "[\"" + trait<Count>::type_name() + "\",\"n\"]";
+  }
+};
+
+template <typename Hist>
+struct multiweight_hist_variation {
+  using multiweight_type = typename Hist::bin_type;
+  using bin_type = multiweight_variation_bin<
+    typename multiweight_type::value_type,
+    decltype(std::declval<const multiweight_type&>().n)>;
+  const Hist& hist;
+  multiweight_variation var;
+};
+
+template <typename Hist>
+inline multiweight_hist_variation<Hist>
+select_variation(const Hist& hist, size_t k) { return { hist, {k} }; }
+
+template <typename Hist>
+struct trait<multiweight_hist_variation<Hist>>
+: hist_trait<typename multiweight_hist_variation<Hist>::bin_type> {
+  static void write_value(
+    std::ostream& o, const multiweight_hist_variation<Hist>& x
+  ) {
+    const auto var = x.var;
+    trait<Hist>::write_value(o,x.hist,
+      [var](std::ostream& o, const auto& bin){
+        scribe::write_values(o,var.val(bin),var.err2(bin),var.num(bin));
+      });
+  }
+};
+
 }}
 
 #endif
@@ -1,26 +1,218 @@
 #include "ivanp/binner/re_axes.hh"
 
 #include <fstream>
+#include <sstream>
+#include <iterator>
 #include <tuple>
 #include <vector>
 #include <utility>
+#include <algorithm>
+#include <unordered_map>
+#include <mutex>
 #include <cctype>
+#include <cstdio>
+#include <cstdint>
+#include <unistd.h>
 
 #include "ivanp/error.hh"
 #include "ivanp/pcre_wrapper.hh"
+#include "ivanp/io/mem_file.hh"
 
 #include <iostream>
 #define TEST(var) \
   std::cout << "\033[36m" #var "\033[0m = " << var << std::endl;
 
-struct re_axes::store: public
-  std::vector<std::pair<ivanp::pcre::regex,axis_type>> { };
+// use lookup table search for axes with more edges than this
+constexpr size_t lut_min_nedges = 64;
 
-re_axes::re_axes(const std::string& filename): _store(new store) {
+// most patterns combined into one regex
+constexpr size_t max_combined = 256;
 
-  std::fstream f(filename);
+namespace {
+
+// group numbers change when patterns are combined,
+// so patterns referring to groups by number, by name (names may repeat
+// between patterns), or in conditions are matched separately
+bool refers_to_groups(const std::string& re) {
+  for (size_t i=0, n=re.size(); i+1<n; ++i) {
+    const char c = re[i+1];
+    if (re[i]=='\\') {
+      if (('1'<=c && c<='9') || c=='g' || c=='k') return true;
+      ++i;
+    } else if (re[i]=='(' && c=='?' && i+2<n) {
+      const char d = re[i+2];
+      if (('0'<=d && d<='9') || d=='R' || d=='&' || d=='+' || d=='(')
+        return true;
+      if (d=='P' && i+3<n && (re[i+3]=='=' || re[i+3]=='>')) return true;
+    }
+  }
+  return false;
+}
+
+// A pattern matches if it matches the whole name, i.e. as ^(?:re)$.
+// Patterns are combined as ^(?:(re1)|(re2)|...)$. The alternatives are
+// tried in order at the start of the name, each with full backtracking,
+// before the next one, so the first pattern that matches wins, as when
+// matching them one by one. The highest set group identifies the
+// pattern that matched.
+struct segment {
+  ivanp::pcre::regex re;
+  std::vector<unsigned> groups; // first group of each pattern
+  size_t first; // index of the first pattern
+  unsigned ngroups;
+
+  segment(const std::vector<std::string>& res, size_t a, size_t b)
+  : re(combine(res,a,b)), first(a) {
+    groups.reserve(b-a);
+    unsigned g = 1;
+    for (size_t i=a; i<b; ++i) {
+      groups.push_back(g);
+      g += 1 + ivanp::pcre::regex(res[i],0,0).capture_count();
+    }
+    ngroups = g;
+  }
+
+  static std::string combine(
+    const std::vector<std::string>& res, size_t a, size_t b
+  ) {
+    if (b-a==1) return "^(?:" + res[a] + ")$";
+    std::string re = "^(?:";
+    for (size_t i=a; i<b; ++i) {
+      if (i!=a) re += '|';
+      (re += '(') += res[i];
+      re += ')';
+    }
+    return re += ")$";
+  }
+
+  // index of the matching pattern or -1
+  size_t operator()(const std::string& name) {
+    ivanp::pcre::match m(ngroups);
+    if (!re(m,name.c_str(),name.size())) return -1;
+    if (groups.size()==1) return first;
+    return first + (std::upper_bound(
+      groups.begin(), groups.end(), m.size()-1) - groups.begin() - 1);
+  }
+};
+
+}
+
+// Binary cache ---------------------------------------------------
+// If enabled, the parsed config is written next to the source as
+// <filename>.cache and mmapped by later processes. Edges of all axes are
+// stored contiguously and used in place. The cache is used only if the
+// recorded size and hash of the source text match the current ones.
+// The format is native endian and not meant to be portable.
+
+namespace {
+
+struct cache_header {
+  char magic[8];
+  uint64_t version, src_size, src_hash;
+  uint64_t nentries, nedges, nchars;
+};
+struct cache_entry {
+  uint64_t re, re_len, edges, nedges, uniform;
+};
+
+constexpr char cache_magic[8] = { 'r','e','_','a','x','e','s','\0' };
+constexpr uint64_t cache_version = 3;
+
+// FNV-1a
+uint64_t text_hash(const std::string& text) noexcept {
+  uint64_t h = 0xcbf29ce484222325ull;
+  for (unsigned char c : text) {
+    h ^= c;
+    h *= 0x100000001b3ull;
+  }
+  return h;
+}
+
+// non-owning edges in the cache image
+struct edge_span {
+  using value_type = double;
+  const double *a = nullptr;
+  size_t n = 0;
+
+  size_t size() const noexcept { return n; }
+  const double* data() const noexcept { return a; }
+  const double* begin() const noexcept { return a; }
+  const double* end() const noexcept { return a+n; }
+  double operator[](size_t i) const noexcept { return a[i]; }
+  double front() const noexcept { return a[0]; }
+  double back() const noexcept { return a[n-1]; }
+};
+
+class image_builder {
+  std::vector<cache_entry> entries;
+  std::vector<double> edges;
+  std::string chars;
+
+  template <typename T>
+  static void append(std::vector<char>& img, const T* x, size_t n) {
+    const char* p = reinterpret_cast<const char*>(x);
+    img.insert(img.end(), p, p+n*sizeof(T));
+  }
+
+public:
+  void add(const std::string& re, const std::vector<double>& nums, bool u) {
+    entries.push_back({ chars.size(), re.size(),
+      edges.size(), nums.size(), u });
+    chars += re;
+    edges.insert(edges.end(), nums.begin(), nums.end());
+  }
+
+  std::vector<char> image(const std::string& src) const {
+    cache_header h { };
+    std::copy(cache_magic, cache_magic+8, h.magic);
+    h.version = cache_version;
+    h.src_size = src.size();
+    h.src_hash = text_hash(src);
+    h.nentries = entries.size();
+    h.nedges = edges.size();
+    h.nchars = chars.size();
+
+    std::vector<char> img;
+    img.reserve(sizeof(h) + entries.size()*sizeof(cache_entry)
+      + edges.size()*sizeof(double) + chars.size());
+    append(img, &h, 1);
+    append(img, entries.data(), entries.size());
+    append(img, edges.data(), edges.size());
+    append(img, chars.data(), chars.size());
+    return img;
+  }
+};
+
+bool valid_image(const char* m, size_t len, const std::string& src) {
+  if (len < sizeof(cache_header)) return false;
+  const auto& h = *reinterpret_cast<const cache_header*>(m);
+  return std::equal(cache_magic, cache_magic+8, h.magic)
+      && h.version  == cache_version
+      && h.src_size == src.size()
+      && h.src_hash == text_hash(src)
+      && len == sizeof(h) + h.nentries*sizeof(cache_entry)
+              + h.nedges*sizeof(double) + h.nchars;
+}
+
+// written to a temporary file and renamed,
+// so concurrent readers never see a partial cache
+void write_image(const std::string& name, const std::vector<char>& img) {
+  const std::string tmp = name + '.' + std::to_string(::getpid());
+  std::ofstream f(tmp, std::ios::binary);
+  if (!f) return; // e.g. read-only directory, the cache is optional
+  f.write(img.data(), img.size());
+  f.close();
+  if (!f || std::rename(tmp.c_str(), name.c_str())) std::remove(tmp.c_str());
+}
+
+std::string read_file(const std::string& filename) {
+  std::ifstream f(filename, std::ios::binary);
   if (f.fail()) throw ivanp::error("Error reading file \"",filename,"\"");
+  return { std::istreambuf_iterator<char>(f),
+           std::istreambuf_iterator<char>() };
+}
 
+void parse(std::istream& f, image_builder& img) {
   char c; // char buffer
   bool e = false, // expression complete
        l = false, // hit left brace
@@ -66,28 +258,13 @@ re_axes::re_axes(const std::string& filename): _store(new store) {
           } else throw ivanp::error("out of place \':\'");
         } else num_str += c;
       } else {
+        push_num(); // number right before '}'
         if (u && nums.size()!=3) throw ivanp::error(
           "more than 3 arguments for uniform axis");
 
-        using axis_ptr = ivanp::abstract_axis<double>*;
-
-        if (re.front()!='^') re = '^' + re;
-        if (re.back()!='$') re += '$';
-
-        _store->emplace_back( std::piecewise_construct,
-          std::tie( re ),
-          std::make_tuple( u
-            ? static_cast<axis_ptr>(
-                new ivanp::uniform_axis<double,true>(
-                nums[0], nums[1], nums[2]))
-            : static_cast<axis_ptr>(
-                new ivanp::container_axis<std::vector<double>,true>(
-                std::move(nums)))
-          )
-        );
+        img.add(re,nums,u);
         re.clear();
-
-        if (u) nums.clear();
+        nums.clear();
 
         e = false;
         l = false;
@@ -95,14 +272,123 @@ re_axes::re_axes(const std::string& filename): _store(new store) {
       }
     }
   } // end while c
+}
+
+// Owns the cache image and the axes that refer to it.
+// Handed out axes share ownership through aliasing shared_ptrs.
+struct axes_arena {
+  ivanp::mem_file file;
+  std::vector<char> buf;
+  std::vector<ivanp::uniform_axis<double,true>> uniform;
+  std::vector<ivanp::container_axis<edge_span,true>> edges;
+  std::vector<ivanp::container_axis<edge_span,true,true>> lut_edges;
+};
+
+}
+
+struct re_axes::store {
+  std::vector<std::string> res;
+  std::vector<axis_type> axes;
+  std::vector<segment> segments;
+  std::unordered_map<std::string,axis_type> cache;
+  std::mutex mx;
+
+  void add_segment(size_t a, size_t b) {
+    try {
+      segments.emplace_back(res,a,b);
+    } catch (const ivanp::pcre::error&) {
+      if (b-a==1) throw;
+      // e.g. duplicate group names or pattern too long
+      for (size_t i=a; i<b; ++i) segments.emplace_back(res,i,i+1);
+    }
+  }
+
+  void compile() {
+    for (size_t a=0, n=res.size(); a<n; ) {
+      size_t b = a+1;
+      if (!refers_to_groups(res[a]))
+        while (b<n && b-a<max_combined && !refers_to_groups(res[b])) ++b;
+      add_segment(a,b);
+      a = b;
+    }
+  }
+
+  void load(std::shared_ptr<axes_arena> arena, const char* m) {
+    const auto& h = *reinterpret_cast<const cache_header*>(m);
+    const auto* entries = reinterpret_cast<const cache_entry*>(m+sizeof(h));
+    const auto* edges = reinterpret_cast<const double*>(entries+h.nentries);
+    const char* chars = reinterpret_cast<const char*>(edges+h.nedges);
+
+    size_t nu = 0, nl = 0;
+    for (size_t i=0; i<h.nentries; ++i) {
+      if (entries[i].uniform) ++nu;
+      else if (entries[i].nedges > lut_min_nedges) ++nl;
+    }
+    // reserved, so that the axes never move
+    arena->uniform.reserve(nu);
+    arena->lut_edges.reserve(nl);
+    arena->edges.reserve(h.nentries-nu-nl);
 
+    res.reserve(h.nentries);
+    axes.reserve(h.nentries);
+    for (size_t i=0; i<h.nentries; ++i) {
+      const cache_entry& e = entries[i];
+      res.emplace_back(chars+e.re, e.re_len);
+      const double* x = edges+e.edges;
+      ivanp::abstract_axis<double>* a;
+      if (e.uniform) {
+        arena->uniform.emplace_back(x[0],x[1],x[2]);
+        a = &arena->uniform.back();
+      } else if (e.nedges > lut_min_nedges) {
+        arena->lut_edges.emplace_back(edge_span{x,e.nedges});
+        a = &arena->lut_edges.back();
+      } else {
+        arena->edges.emplace_back(edge_span{x,e.nedges});
+        a = &arena->edges.back();
+      }
+      axes.emplace_back(std::shared_ptr<ivanp::abstract_axis<double>>(arena,a));
+    }
+    compile();
+  }
+};
+
+re_axes::re_axes(const std::string& filename, bool use_cache)
+: _store(new store) {
+  const std::string src = read_file(filename);
+  const std::string cache_name = filename + ".cache";
+
+  auto arena = std::make_shared<axes_arena>();
+  const char* m = nullptr;
+  if (use_cache) {
+    try {
+      auto f = ivanp::mem_file::mmap(cache_name.c_str());
+      if (valid_image(f.mem(), f.size(), src)) {
+        m = f.mem();
+        arena->file = std::move(f);
+      }
+    } catch (const ivanp::error&) { } // no cache yet
+  }
+  if (!m) {
+    image_builder img;
+    std::istringstream f(src);
+    parse(f,img);
+    arena->buf = img.image(src);
+    if (use_cache) write_image(cache_name, arena->buf);
+    m = arena->buf.data();
+  }
+  _store->load(std::move(arena), m);
 }
 
 re_axes::~re_axes() { delete _store; }
 
 re_axes::axis_type re_axes::operator[](const std::string& name) const {
-  ivanp::pcre::match m;
-  for (auto& ra : *_store)
-    if (ra.first(m,name.c_str(),name.size())) return ra.second;
+  std::lock_guard<std::mutex> lock(_store->mx);
+  auto it = _store->cache.find(name);
+  if (it != _store->cache.end()) return it->second;
+  for (auto& seg : _store->segments) {
+    const size_t i = seg(name);
+    if (i != size_t(-1))
+      return _store->cache.emplace(name,_store->axes[i]).first->second;
+  }
   throw ivanp::error("No binning found for \"", name, '\"');
 }
@@ -0,0 +1,72 @@
+// Merges binner snapshots written by write_snapshot.
+// Inputs are grouped by file name, so that the same histogram from many
+// jobs is summed into one output file of that name in the output
+// directory. The bin type is given with -t and must match the type
+// recorded in the snapshots.
+//
+//   merge_snapshots job*/*.bin -o merged -t weight -j 16
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ivanp/program_options.hh"
+#include "ivanp/binner/merge.hh"
+#include "ivanp/binner/soa_bins.hh"
+
+using namespace ivanp;
+
+template <typename Bin>
+void merge_all(const std::map<std::string,std::vector<std::string>>& groups,
+  const std::string& odir, unsigned nthreads, bool verify
+) {
+  for (const auto& g : groups) {
+    std::cout << g.first << ": " << g.second.size() << " files" << std::endl;
+    merge_snapshots<Bin>(odir+'/'+g.first, g.second, nthreads, verify);
+  }
+}
+
+int main(int argc, char* argv[]) {
+  std::vector<std::string> ifnames;
+  std::string odir, type = "weight";
+  unsigned nthreads = detail::merge::default_nthreads();
+  bool no_verify = false;
+
+  try {
+    using namespace ivanp::po;
+    if (program_options()
+      (ifnames,{},"input snapshots",pos(),req())
+      (odir,'o',"output directory",req())
+      (type,'t',"bin type: weight, double, float, count\n"
+                "default: weight")
+      (nthreads,'j',"number of threads")
+      (no_verify,"--no-verify","skip checksums of inputs")
+      .parse(argc,argv,true)) return 0;
+  } catch (const std::exception& e) {
+    std::cerr << "\033[31m" << e.what() << "\033[0m" << std::endl;
+    return 1;
+  }
+
+  std::map<std::string,std::vector<std::string>> groups;
+  for (const auto& name : ifnames) {
+    const auto slash = name.rfind('/');
+    groups[slash==std::string::npos ? name : name.substr(slash+1)]
+      .push_back(name);
+  }
+
+  try {
+    if (type=="weight")
+      merge_all<weight_bin<>>(groups,odir,nthreads,!no_verify);
+    else if (type=="double")
+      merge_all<double>(groups,odir,nthreads,!no_verify);
+    else if (type=="float")
+      merge_all<float>(groups,odir,nthreads,!no_verify);
+    else if (type=="count")
+      merge_all<unsigned long>(groups,odir,nthreads,!no_verify);
+    else throw error("unknown bin type \"",type,'\"');
+  } catch (const std::exception& e) {
+    std::cerr << "\033[31m" << e.what() << "\033[0m" << std::endl;
+    return 1;
+  }
+}